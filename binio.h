@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file binio.h
+ * @brief Portable little-endian binary I/O of numbers
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * Internal to the library, shared by tile summaries and checkpoints.
+ */
+
+#ifndef BINIO_H
+#define BINIO_H
+
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include <cstring>
+
+inline void put32(std::ostream& s, uint32_t v) {
+    char b[4] = {(char)v, (char)(v>>8), (char)(v>>16), (char)(v>>24)};
+    s.write(b, 4);
+}
+
+inline void put_float(std::ostream& s, float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, 4);
+    put32(s, u);
+}
+
+inline void put_double(std::ostream& s, double d) {
+    uint64_t u;
+    std::memcpy(&u, &d, 8);
+    put32(s, (uint32_t)u);
+    put32(s, (uint32_t)(u>>32));
+}
+
+inline uint32_t get32(std::istream& s) {
+    unsigned char b[4] = {0,0,0,0};
+    s.read((char*)b, 4);
+    return b[0] | b[1]<<8 | b[2]<<16 | (uint32_t)b[3]<<24;
+}
+
+inline float get_float(std::istream& s) {
+    uint32_t u = get32(s);
+    float f;
+    std::memcpy(&f, &u, 4);
+    return f;
+}
+
+inline double get_double(std::istream& s) {
+    uint64_t u = get32(s);
+    u |= (uint64_t)get32(s)<<32;
+    double d;
+    std::memcpy(&d, &u, 8);
+    return d;
+}
+
+#endif
@@ -1,22 +1,11 @@
 #include "cc.h"
-#include <list>
+#include "rect.h"
+#include "trace.h"
 #include <algorithm>
 #include <cassert>
-
-DPoint pos2DPoint(Pos p) {
-    return DPoint((double)p.x, (double)p.y);
-}
-
-DPoint min(const DPoint& p1, const DPoint& p2) {
-    return DPoint(std::min(p1.x,p2.x), std::min(p1.y,p2.y));
-}
-
-struct Rect {
-    Pos tl, br; ///< Top-left and bottom-right corners of rectangle
-    std::list<std::list<int>> chainCode[4];
-    Rect(Pos topLeft, Pos bottomRight);
-    Rect(CC& cc, Pos p, float lvl[4]);
-};
+#include <cmath>
+#include <iterator>
+#include <limits>
 
 struct CompareValue {
     const float* lvl;
@@ -41,9 +30,44 @@ int edge_id(int i, int j) {
 
 Rect::Rect(Pos topLeft, Pos bottomRight) : tl(topLeft), br(bottomRight) {}
 
+/// Interpolation policies in dual pixels with the two smallest levels
+/// diagonally opposite, of vertices \a vo ordered by level. Bilinear
+/// interpolation has a saddle point there, a virtual sample, and an mme in
+/// each quadrant around it.
+struct Bilinear {
+    static int saddle(CC& cc, Pos p, float lvl[4], const Pos*) {
+        return cc.create_saddle(p, lvl);
+    }
+    static Mme mme(const CC& cc, Pos p, Pos v) {
+        return Mme(cc.idx(p), v.x!=p.x, v.y!=p.y);
+    }
+};
+
+/// A digital connectivity has no saddle: the vertex of rank \a J in
+/// increasing levels joins the opposite one through the center of the dual
+/// pixel, which splits the mme in quadrants as a saddle does. No level is
+/// interpolated and the continuum between vertex and saddle is not created.
+template <int J>
+struct Digital : Bilinear {
+    static int saddle(CC& cc, Pos p, float*, const Pos* vo) {
+        const Pos& o = vo[J^1]; // Opposite vertex
+        if(cc.contours[cc.idx(o)].lvl == cc.contours[cc.idx(vo[J])].lvl)
+            cc.merge_contours(vo[J], o);
+        int root = cc.root_contour(vo[J]);
+        Contour c;
+        c.parent = root;
+        c.p = DPoint(p.x+.5, p.y+.5);
+        c.lvl = cc.contours[root].lvl;
+        cc.saddles[cc.idx(p)] = (int)cc.contours.size();
+        cc.contours.push_back(c);
+        return root;
+    }
+};
+
 /// Constructor of rectangle of size 1x1, needing the four levels to build
-/// the chain-codes.
-Rect::Rect(CC& cc, Pos p, float lvl[4]) : tl(p), br(p.x+1,p.y+1) {
+/// the chain-codes, with interpolation policy \a I.
+template <typename I>
+Rect::Rect(CC& cc, Pos p, float lvl[4], I) : tl(p), br(p.x+1,p.y+1) {
     const Pos v[] = {tl, Pos(br.x,tl.y), br, Pos(tl.x,br.y)};
     int rank[4] = {0,1,2,3};
     std::sort(rank, rank+4, CompareValue(lvl));
@@ -53,19 +77,24 @@ Rect::Rect(CC& cc, Pos p, float lvl[4]) : tl(p), br(p.x+1,p.y+1) {
     int c[4] = {-1,-1,-1,-1}; // Up to 4 continua
     if(((rank[0]+rank[1])&1) == 0) { // Smallest two diagonally opposite
         if(lvl[rank[1]] < lvl[rank[2]]) { // Saddle
-            Pos s=cc.create_saddle(p, lvl);
-            int idx=cc.idx(s);
-            Contour& ctr = cc.contours[idx];
-            ctr.p.x += p.x; ctr.p.y += p.y;
-            for(int i=0; i<4; i++) {
-                DPoint p = min(pos2DPoint(vo[i]),ctr.p);
-                c[i] = cc.create_continuum(vo[i], s, p);
-            }
+            int idx = I::saddle(cc, p, lvl, vo);
+            for(int i=0; i<4; i++) // mme at min of vertex and saddle
+                if(cc.root_contour(vo[i]) != idx)
+                    c[i] = cc.create_continuum(cc.idx(vo[i]), idx,
+                                               I::mme(cc, p, vo[i]));
             for(int i=0; i<=1; i++)
                 for(int j=2; j<=3; j++) {
                     int eid = edge_id(rank[i],rank[j]);
-                    chainCode[eid].push_back(
-                     std::list<int>{cc.root_contour(vo[i]),c[i],idx,c[j],cc.root_contour(vo[j])});
+                    std::list<int> L(1, cc.root_contour(vo[i]));
+                    if(c[i] >= 0) {
+                        L.push_back(c[i]);
+                        L.push_back(idx);
+                    }
+                    if(c[j] >= 0) {
+                        L.push_back(c[j]);
+                        L.push_back(cc.root_contour(vo[j]));
+                    }
+                    chainCode[eid].push_back(L);
                 }
             return;
         }
@@ -78,7 +107,7 @@ Rect::Rect(CC& cc, Pos p, float lvl[4]) : tl(p), br(p.x+1,p.y+1) {
         chainCode[i].emplace_back(L);
     }
 
-    DPoint dtl = pos2DPoint(tl);
+    Mme dtl(cc.idx(tl));
     int eMin = edge_id(rank[0], rank[1]);
     chainCode[eMin].back().push_back(cc.root_contour(vo[0]));
     if(lvl[rank[0]]==lvl[rank[1]])
@@ -176,9 +205,10 @@ bool insert_chainCode(CC& cc, std::list<int>& L, int iSplit, int iCtn, int iCtr)
 /// Mark continuum \a iCtn and contour \a iCtr crossing the continuum of index
 /// \a iSplit. This is for the exit edge of the last mme of \a iSplit out of
 /// \a R. The side \a iSideIn (0..3), representing entry edge, must be skipped
-/// from the search of exit edge.
+/// from the search of exit edge. An exit to the outside of the domain of a
+/// masked image is not recorded.
 void mark_exit(CC& cc, Rect& R, int iSplit, int iCtn, int iCtr, int iSideIn) {
-    const DPoint& p = cc.continua[iSplit].mme.back();
+    const DPoint p = cc.point(cc.continua[iSplit].mme.back());
     if(iSideIn != 0 && p.y == R.tl.y) { // Upper edge
         std::list<std::list<int>>::iterator i = R.chainCode[0].begin();
         std::advance(i, (int)p.x-R.tl.x);
@@ -204,7 +234,19 @@ void mark_exit(CC& cc, Rect& R, int iSplit, int iCtn, int iCtr, int iSideIn) {
         if( insert_chainCode(cc, *i, iSplit, iCtn, iCtr) )
             return;
     }
-    assert(false);
+    // Otherwise the exit is on the boundary of the domain of a masked image
+    if(cc.saddles.empty()) // Sparse C&C, levels of pixels unknown
+        return;
+    bool boundary = false;
+    for(int k=0; k<4; k++) { // Dual pixels adjacent to the one of p
+        int x=(int)p.x+(k==1)-(k==3), y=(int)p.y+(k==2)-(k==0);
+        if(x<0 || y<0 || x+1>=cc.w || y+1>=cc.h)
+            continue;
+        const Contour* c = &cc.contours[cc.idx(x,y)];
+        if(std::isnan(c[0].lvl+c[1].lvl+c[cc.w].lvl+c[cc.w+1].lvl))
+            boundary = true;
+    }
+    (void)boundary; assert(boundary);
 }
 
 /// Check if m<n=i or n<m=i.
@@ -228,10 +270,10 @@ int find_side_entry(const DPoint& src, const DPoint& dst) {
 /// All crossings through edges at the same level as \a sep are recorded in
 /// the chain codes.
 void split_continuum(CC& cc, Rect& Rsrc, Rect& Rdst,
-                     std::vector<DPoint>::iterator it, Pos sep,
+                     std::vector<Mme>::iterator it, Pos sep,
                      int iSplit, int iCtn, int iCtr, int iSideIn) {
     cc.continua[iSplit].infCtr = iCtr;
-    const DPoint& p = *it;
+    DPoint p = cc.point(*it);
     const int dir = iSideIn&1; // adjacency of rects: 0=horizontal, 1=vertical
     std::list<std::list<int>>::iterator i = Rdst.chainCode[iSideIn].begin();
     std::advance(i, (int)p[dir]-Rdst.tl[dir]);
@@ -240,32 +282,37 @@ void split_continuum(CC& cc, Rect& Rsrc, Rect& Rdst,
     Rect* R[2] = {&Rsrc, &Rdst};
     int ori[2] = {(iSideIn+2)%4, iSideIn};
     int side=1;
-    std::vector<DPoint>::iterator itn=std::next(it),
+    std::vector<Mme>::iterator itn=std::next(it),
       end=cc.continua[iCtn].mme.end();
     int dim=1-dir, lim=sep[dim];
-    for(; itn!=end; it=itn++)
-        if(inside(lim, (*it)[dim], (*itn)[dim])) { // Crossing
+    for(; itn!=end; it=itn++) {
+        DPoint q = cc.point(*itn);
+        if(inside(lim, p[dim], q[dim])) { // Crossing
            i = R[side]->chainCode[ori[side]].begin();
-           std::advance(i, (int)(*it)[dir]-Rsrc.tl[dir]);
+           std::advance(i, (int)p[dir]-Rsrc.tl[dir]);
            bool b = insert_chainCode(cc, *i, iSplit, iCtn, iCtr);
            (void)b; assert(b);
            side = 1-side;
            i = R[side]->chainCode[ori[side]].begin();
-           std::advance(i, (int)(*it)[dir]-Rsrc.tl[dir]);
+           std::advance(i, (int)p[dir]-Rsrc.tl[dir]);
            b = insert_chainCode(cc, *i, iSplit, iCtn, iCtr);
            (void)b; assert(b);
         }
-    iSideIn = find_side_entry(*std::prev(it), *it);
+        p = q;
+    }
+    iSideIn = find_side_entry(cc.point(*std::prev(it)), p);
     mark_exit(cc, *R[side], iSplit, iCtn, iCtr, iSideIn);
 }
 
 /// Given two chain-codes \a L1 and \a L2 along a common edge, merge or split
 /// continua, merge contours. The vertical common edge has top-left endpoint
 /// at \a sep and orientation \a o (1=horizontal, 0=vertical). The
-/// enclosing rectangles \a R1 and \a R2 are adjacent.
+/// enclosing rectangles \a R1 and \a R2 are adjacent. An empty chain code
+/// is outside the domain, nothing crosses the edge.
 void propagate(CC& cc, Rect& R1, Rect& R2, Pos sep, int o,
                const std::list<int>& L1, const std::list<int>& L2) {
-    assert(!L1.empty() && !L2.empty());
+    if(L1.empty() || L2.empty())
+        return;
     std::list<int>::const_iterator i1=L1.begin(), i2=L2.begin();
     //    assert(*i1 == *i2); // TODO: find better check, *i1 and *i2 must have merged, not be identical
     ++i1; ++i2;
@@ -273,7 +320,7 @@ void propagate(CC& cc, Rect& R1, Rect& R2, Pos sep, int o,
         assert(i2 == L2.end());
         return;
     }
-    std::vector<DPoint>::iterator it;
+    std::vector<Mme>::iterator it;
     int ic1 = cc.root_continuum(*i1++);
     int ic2 = cc.root_continuum(*i2++);
     int j1 = cc.root_contour(*i1++);
@@ -285,16 +332,16 @@ void propagate(CC& cc, Rect& R1, Rect& R2, Pos sep, int o,
             if(j1 != j2)
                 cc.contours[j2].parent = j1;
             if(ic1 != ic2) {
-                cc.merge_mme(cc.continua[ic1].mme, cc.continua[ic2].mme, sep,o);
+                cc.merge_mme(ic1, ic2, sep, o);
                 cc.continua[ic2].parent = ic1;
                 cc.continua[ic2].mme.clear();
                 cc.continua[ic2].mme.shrink_to_fit();
             }
         } else if(l1<l2) { // split continuum ic2
-            it= cc.merge_mme(cc.continua[ic1].mme, cc.continua[ic2].mme, sep,o);
+            it= cc.merge_mme(ic1, ic2, sep, o);
             split_continuum(cc, R1, R2, it, sep, ic2, ic1, j1, (o+3)%4);
         } else if(l2<l1) { // split continuum ic1
-            it= cc.merge_mme(cc.continua[ic2].mme, cc.continua[ic1].mme, sep,o);
+            it= cc.merge_mme(ic2, ic1, sep, o);
             split_continuum(cc, R2, R1, it, sep, ic1, ic2, j2, o+1);
         }
         float l1old=l1;
@@ -318,13 +365,33 @@ void propagate(CC& cc, Rect& R1, Rect& R2, Pos sep, int o,
     ic1 = cc.root_continuum(ic1);
     ic2 = cc.root_continuum(ic2);
     if(ic1!=ic2) {
-        cc.merge_mme(cc.continua[ic1].mme, cc.continua[ic2].mme, sep,o);
+        cc.merge_mme(ic1, ic2, sep, o);
         cc.continua[ic2].parent = ic1;
         cc.continua[ic2].mme.clear();
         cc.continua[ic2].mme.shrink_to_fit();
     }
 }
 
+static const CCTrace::Kind traceBuild = {"build", {"w","h",0}};
+static const CCTrace::Kind traceLeaves = {"leaves", {"w","h",0}};
+static const CCTrace::Kind traceLevel = {"level", {"level","rects",0}};
+static const CCTrace::Kind traceMerge = {"merge_rectangles",{"w","h","edge"}};
+static const CCTrace::Kind tracePropagate = {"propagate", {"entries","x","y"}};
+
+/// Append side \a S2 of \a n2 edges to side \a S1 of \a n1 edges. An empty
+/// side, outside the domain, gets empty chain codes if the other is not.
+static void append_side(std::list<std::list<int>>& S1, int n1,
+                        std::list<std::list<int>>& S2, int n2) {
+    if(S1.empty() && S2.empty())
+        return;
+    if(S1.empty())
+        S1.resize(n1);
+    if(S2.empty())
+        S1.resize(n1+n2);
+    else
+        S1.splice(S1.end(), S2);
+}
+
 /// Merge two adjacent rectangles, separated by vertical edges.
 Rect merge_rectangles(CC& cc, Rect& R1, Rect& R2) {
     int o = -1; // Relative orientation of R1 and R2. 0,1=horizontal,vertical
@@ -334,50 +401,261 @@ Rect merge_rectangles(CC& cc, Rect& R1, Rect& R2) {
         o=0; // Horizontal edges, vertical neighbors
     assert(o==0 || o==1);
     int o1=o+1, o2=(o1+2)%4;
+    CCTrace* trace = cc.trace();
+    CCSpan span(trace, traceMerge, R2.br.x-R1.tl.x, R2.br.y-R1.tl.y,
+                (int)R1.chainCode[o1].size());
 
-    // Propagate chain-codes along common edges
-    assert(R1.chainCode[o1].size()==R2.chainCode[o2].size());
+    // Propagate chain-codes along common edges, unless one is outside domain
     std::list<std::list<int>>::const_iterator i1=R1.chainCode[o1].begin(),
                                               i2=R2.chainCode[o2].begin(),
                                               end=R1.chainCode[o1].end();
+    if(R2.chainCode[o2].empty())
+        end = i1;
+    assert(i1==end || R1.chainCode[o1].size()==R2.chainCode[o2].size());
     Pos sep = R2.tl;
-    for(; i1!=end; ++i1, ++i2, ++sep[1-o])
-        propagate(cc, R1, R2, sep, o, *i1, *i2);
+    for(; i1!=end; ++i1, ++i2, ++sep[1-o]) {
+        if(cc.interrupted())
+            break;
+        if(trace && i1->size()+i2->size() >= trace->minPropagate) {
+            CCSpan span(trace, tracePropagate, (int)(i1->size()+i2->size()),
+                        sep.x, sep.y);
+            propagate(cc, R1, R2, sep, o, *i1, *i2);
+        } else
+            propagate(cc, R1, R2, sep, o, *i1, *i2);
+    }
 
     // Move chain-codes at frame of R
     Rect R(R1.tl, R2.br);
     std::swap(R1.chainCode[o2],R.chainCode[o2]);
     std::swap(R2.chainCode[o1],R.chainCode[o1]);
-    std::swap(R1.chainCode[o],R.chainCode[o]);
-    R.chainCode[o].splice(R.chainCode[o].end(),R2.chainCode[o]);
-    o += 2;
-    std::swap(R1.chainCode[o],R.chainCode[o]);
-    R.chainCode[o].splice(R.chainCode[o].end(),R2.chainCode[o]);
+    const int n1=R1.br[o]-R1.tl[o], n2=R2.br[o]-R2.tl[o];
+    for(int k=0; k<2; k++, o+=2) {
+        std::swap(R1.chainCode[o],R.chainCode[o]);
+        append_side(R.chainCode[o], n1, R2.chainCode[o], n2);
+    }
     return R;
 }
 
-/// Constructor with image.
-CC::CC(const float* im, int w, int h): w(w), h(h) {
-    contours = new Contour[2*w*h]; // 2x due to virtual samples
+/// Number of dual pixels of image \a im containing a saddle point: one
+/// diagonal is strictly below the other one.
+template <typename T>
+static size_t count_saddles(const T* im, int w, int h) {
+    size_t n=0;
+    for(int i=0; i+1<h; i++, im++)
+        for(int j=0; j+1<w; j++, im++) {
+            float a=(float)im[0], b=(float)im[1], c=(float)im[w+1], d=(float)im[w];
+            if(std::max(a,c) < std::min(b,d) || std::max(b,d) < std::min(a,c))
+                ++n;
+        }
+    return n;
+}
+
+/// Constructor with image. The image is read in place, whatever its type.
+template <typename T>
+CC::CC(const T* im, int w, int h, const CCOptions& opt, CCContext* ctx,
+       const unsigned char* mask)
+: w(w), h(h), opt(opt), status(CC_OK), ctx(ctx), ticks(0) {
+    const size_t n = (size_t)w*h;
+    std::vector<bool> valid(n);
+    for(size_t i=0; i<n; i++)
+        valid[i] = (!mask || mask[i]) && !std::isnan((float)im[i]);
+    contours.reserve(n + count_saddles(im, w, h));
+    contours.resize(n);
+    saddles.assign(n, -1);
     for(int i=0,idx=0; i<h; i++)
         for(int j=0; j<w; j++,idx++) {
             contours[idx].p = DPoint(j,i);
-            contours[idx].lvl = im[idx];
+            contours[idx].lvl = valid[idx]? (float)im[idx]:
+                std::numeric_limits<float>::quiet_NaN();
         }
-    std::vector<Rect> R;
-    for(int i=0; i+1<h; i++)
+    build();
+}
+
+template CC::CC(const float*, int, int, const CCOptions&, CCContext*,
+                const unsigned char*);
+template CC::CC(const unsigned char*, int, int, const CCOptions&, CCContext*,
+                const unsigned char*);
+template CC::CC(const unsigned short*, int, int, const CCOptions&, CCContext*,
+                const unsigned char*);
+
+/// Empty C&C of an image of size \a w x \a h: contours of pixels at level
+/// NaN, unknown, no saddle and no continuum. It is filled from partial
+/// results, such as a checkpoint. If not \a dense, there is no contour at
+/// all and saddles are in sparseSaddles: the caller appends the contours it
+/// needs, so that memory is proportional to the partial results, such as
+/// tile summaries, and not to the image.
+CC::CC(int w, int h, const CCOptions& opt, CCContext* ctx, bool dense)
+: w(w), h(h), opt(opt), status(CC_OK), ctx(ctx), ticks(0) {
+    if(! dense)
+        return;
+    const size_t n = (size_t)w*h;
+    contours.resize(n);
+    saddles.assign(n, -1);
+    for(int i=0,idx=0; i<h; i++)
+        for(int j=0; j<w; j++,idx++) {
+            contours[idx].p = DPoint(j,i);
+            contours[idx].lvl = std::numeric_limits<float>::quiet_NaN();
+        }
+}
+
+CC::~CC() {}
+
+/// Contour index of the saddle of dual pixel \a i in a sparse C&C, -1 if
+/// none.
+int CC::sparse_saddle(int i) const {
+    std::unordered_map<int,int>::const_iterator it = sparseSaddles.find(i);
+    return (it==sparseSaddles.end())? -1: it->second;
+}
+
+/// Set the deadline \a ms milliseconds from now.
+void CCContext::set_timeout(double ms) {
+    hasDeadline = true;
+    deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double,std::milli>(ms));
+}
+
+/// Status of construction according to cancellation flag and deadline.
+CCStatus CCContext::check() const {
+    if(cancelled)
+        return CC_CANCELLED;
+    if(hasDeadline && std::chrono::steady_clock::now() >= deadline)
+        return CC_TIMEOUT;
+    return CC_OK;
+}
+
+/// Check the context, if any, every 1024 calls or if \a force is set.
+/// On interruption, the status is set and the construction must stop.
+bool CC::interrupted(bool force) {
+    if(status == CC_OK && ctx && ((++ticks&1023)==0 || force))
+        status = ctx->check();
+    return status != CC_OK;
+}
+
+/// Report progress after level \a level out of \a nLevels.
+static void report(CCContext* ctx, int level, int nLevels) {
+    if(ctx && ctx->progress)
+        ctx->progress(level, nLevels, ctx->data);
+}
+
+/// Report root continua absent from the chain codes of rectangles \a R and
+/// not yet reported (marked in \a done). Continua are modified only through
+/// the chain codes, so these ones are final.
+void report_finalized(CC& cc, CCContext* ctx, const std::vector<Rect>& R,
+                      std::vector<bool>& done) {
+    if(!ctx || !ctx->finalized)
+        return;
+    std::vector<bool> open(cc.continua.size(), false);
+    for(size_t k=0; k<R.size(); k++)
+        for(int i=0; i<4; i++)
+            for(const std::list<int>& L: R[k].chainCode[i]) {
+                std::list<int>::const_iterator it=L.begin();
+                while(it!=L.end() && ++it!=L.end()) // Odd elements: continua
+                    open[cc.root_continuum(*it++)] = true;
+            }
+    done.resize(cc.continua.size(), false);
+    for(size_t i=0; i<done.size(); i++)
+        if(!done[i] && !open[i] && cc.continua[i].parent<0) {
+            done[i] = true;
+            ctx->finalized(cc, (int)i, ctx->data);
+        }
+}
+
+/// Topology mode: keep only the mme a later merge of rectangles \a R may
+/// use, two at each end of the chain and those in dual pixels along an
+/// edge of a rectangle, where the crossings of later splits are located.
+static void compact_mme(CC& cc, const std::vector<Rect>& R) {
+    std::vector<bool> bx(cc.w,false), by(cc.h,false); // Lines of edges
+    for(const Rect& r: R) {
+        bx[r.tl.x] = bx[r.br.x] = true;
+        by[r.tl.y] = by[r.br.y] = true;
+    }
+    for(Continuum& c: cc.continua) {
+        std::vector<Mme>& v = c.mme;
+        if(v.size() <= 4)
+            continue;
+        size_t n=2;
+        for(size_t k=2; k+2<v.size(); k++) {
+            int x=v[k].cell()%cc.w, y=v[k].cell()/cc.w;
+            if(bx[x] || bx[x+1] || by[y] || by[y+1])
+                v[n++] = v[k];
+        }
+        v[n++] = v[v.size()-2];
+        v[n++] = v.back();
+        v.resize(n);
+        if(2*n < v.capacity())
+            v.shrink_to_fit();
+    }
+}
+
+/// Rectangles of the dual pixels, with interpolation policy \a I, in \a R.
+/// A dual pixel with an invalid corner (level NaN) is outside the domain: its
+/// rectangle has no chain code. Return false if interrupted.
+template <typename I>
+bool CC::build_leaves(std::vector<Rect>& R) {
+    for(int i=0; i+1<h; i++) {
+        if(interrupted(true))
+            return false;
         for(int j=0; j+1<w; j++) {
             int idx = i*w+j;
-            float lvl[4] = { im[idx], im[idx+1], im[idx+1+w], im[idx+w] };
-            R.push_back(Rect(*this,Pos(j,i),lvl));
+            float lvl[4] = { contours[idx].lvl,   contours[idx+1].lvl,
+                             contours[idx+1+w].lvl, contours[idx+w].lvl };
+            if(std::isnan(lvl[0]+lvl[1]+lvl[2]+lvl[3]))
+                R.push_back(Rect(Pos(j,i),Pos(j+1,i+1)));
+            else
+                R.push_back(Rect(*this,Pos(j,i),lvl,I()));
+        }
+    }
+    return true;
+}
+
+/// Number of levels of the pyramid of an image of size \a w x \a h: the
+/// leaves, then each level halves width and height.
+static int nb_levels(int w, int h) {
+    int n=1;
+    for(int w2=w-1, h2=h-1; w2>1 || h2>1; w2=(w2+1)/2, h2=(h2+1)/2)
+        ++n;
+    return n;
+}
+
+/// Build C&C from the levels of the contours of pixels. If interrupted, the
+/// C&C is left as it was at that point and status tells why.
+void CC::build() {
+    CCSpan span(trace(), traceBuild, w, h);
+    std::vector<Rect> R;
+    bool ok = false;
+    {
+        CCSpan span(trace(), traceLeaves, w, h);
+        switch(opt.connectivity) {
+        case CC_BILINEAR: ok = build_leaves<Bilinear>(R); break;
+        case CC_LOWER4:   ok = build_leaves<Digital<2>>(R); break;
+        case CC_LOWER8:   ok = build_leaves<Digital<1>>(R); break;
         }
-    // C&C propagation
-    int w2=w-1, h2=h-1;
-    while(w2>1 || h2>1) {
+    }
+    if(! ok)
+        return;
+    report(ctx, 0, nb_levels(w,h));
+    std::vector<bool> done; // Continua reported as finalized
+    report_finalized(*this, ctx, R, done);
+    build_pyramid(R, done, 1, w-1, h-1);
+}
+
+/// C&C propagation: merge the rectangles \a R, an array of size \a w2 x
+/// \a h2, from level \a level of the pyramid up. Continua marked in \a done
+/// were already reported as finalized. At the end of levels, the state is
+/// saved to the checkpoint file of the context, if any.
+void CC::build_pyramid(std::vector<Rect>& R, std::vector<bool>& done,
+                       int level, int w2, int h2) {
+    const int nLevels = nb_levels(w,h);
+    std::chrono::steady_clock::time_point saved=std::chrono::steady_clock::now();
+    for(; w2>1 || h2>1; level++) {
+        CCSpan span(trace(), traceLevel, level, (int)R.size());
         // Horizontal propagation
         size_t n=R.size();
         for(int i=0; i<h2; i++) {
             for(int j=0; j+1<w2; j+=2) {
+                if(interrupted())
+                    return;
                 Rect r = merge_rectangles(*this, R[i*w2+j], R[i*w2+j+1]);
                 R.push_back(r);
             }
@@ -390,6 +668,8 @@ CC::CC(const float* im, int w, int h): w(w), h(h) {
         n = R.size();
         for(int i=0; i+1<h2; i+=2) {
             for(int j=0; j<w2; j++) {
+                if(interrupted())
+                    return;
                 Rect r = merge_rectangles(*this, R[i*w2+j], R[(i+1)*w2+j]);
                 R.push_back(r);
             }
@@ -399,41 +679,106 @@ CC::CC(const float* im, int w, int h): w(w), h(h) {
                 R.push_back(R[(h2-1)*w2+j]);
         R.erase(R.begin(), R.begin()+n);
         h2=(h2+1)/2;
+        if(interrupted(true))
+            return;
+        report(ctx, level, nLevels);
+        report_finalized(*this, ctx, R, done);
+        if(opt.topology)
+            compact_mme(*this, R);
+        if(ctx && !ctx->checkpoint.empty() && (w2>1 || h2>1)) {
+            std::chrono::steady_clock::time_point t =
+                std::chrono::steady_clock::now();
+            if(std::chrono::duration<double>(t-saved).count() >=
+               ctx->checkpointPeriod) {
+                save_checkpoint(ctx->checkpoint, R, done, level+1, w2, h2);
+                saved = t;
+            }
+        }
+    }
+    if(opt.keepFrame && !R.empty()) { // Not final, may be merged in CCTile
+        frame.reset(new Rect(std::move(R[0])));
+        return;
+    }
+    R.clear(); // Remaining continua are on the frame of the image
+    report_finalized(*this, ctx, R, done);
+    if(opt.topology)
+        for(Continuum& c: continua)
+            std::vector<Mme>().swap(c.mme);
+}
+
+/// Decode the top-left corner of mme \a m.
+DPoint CC::point(Mme m) const {
+    int i = m.cell();
+    DPoint p(i%w, i/w);
+    if(m.code & 3) {
+        const DPoint& s = contours[saddle(i)].p; // Saddle of dual pixel
+        if(m.saddleX())
+            p.x = s.x;
+        if(m.saddleY())
+            p.y = s.y;
     }
+    return p;
+}
+
+/// Attributes of the single mme \a m. The integral of the bilinear
+/// interpolation over the rectangle is separable in x and y.
+CCAttr CC::mme_attr(Mme m) const {
+    CCAttr a;
+    a.tl = point(m);
+    a.br = mme_br(a.tl);
+    double w=a.br.x-a.tl.x, h=a.br.y-a.tl.y;
+    a.area = w*h;
+    a.chainLength = 2*(w+h);
+    int i = m.cell();
+    double x0=a.tl.x-i%this->w, x1=x0+w, y0=a.tl.y-i/this->w, y1=y0+h;
+    double U1=(x1*x1-x0*x0)/2, U0=w-U1; // Integrals of u and 1-u
+    double V1=(y1*y1-y0*y0)/2, V0=h-V1;
+    a.sumLvl = contours[i].lvl*U0*V0 + contours[i+1].lvl*U1*V0 +
+        contours[i+1+this->w].lvl*U1*V1 + contours[i+this->w].lvl*U0*V1;
+    return a;
 }
 
 /// Return bottom-right corner of mme whose top-left corner is \a p.
 DPoint CC::mme_br(const DPoint& p) const {
-    DPoint q = contours[idx(Pos((int)p.x,(int)p.y+h))].p;
-    if(q.x<0 || p.x == q.x)
-        q.x = (int)p.x+1;
-    if(q.y<0 || p.y == q.y)
-        q.y = (int)p.y+1;
+    DPoint q((int)p.x+1, (int)p.y+1);
+    int i = saddle((int)p.x, (int)p.y);
+    if(i >= 0) {
+        const DPoint& s = contours[i].p;
+        if(p.x != s.x)
+            q.x = s.x;
+        if(p.y != s.y)
+            q.y = s.y;
+    }
     return q;
 }
 
 /// Create a virtual sample (saddle point) in dual pixel at p.
-Pos CC::create_saddle(Pos p, float lvl[4]) {
-    p.y += h;
-    int i = idx(p);
-    Contour& c = contours[i];
+/// Return its index in contours.
+int CC::create_saddle(Pos p, float lvl[4]) {
+    int i = (int)contours.size();
+    Contour c;
     float num=   lvl[0]*lvl[2] - lvl[1]*lvl[3];
     float denom=(lvl[0]+lvl[2])-(lvl[1]+lvl[3]);
-    c.p.x = (lvl[0]-lvl[1])/denom;
-    c.p.y = (lvl[0]-lvl[3])/denom;
+    c.p.x = (lvl[0]-lvl[3])/denom; // Zero of derivative in y
+    c.p.y = (lvl[0]-lvl[1])/denom; // Zero of derivative in x
+    c.p.x += p.x; c.p.y += p.y;
     c.lvl = num/denom;
-    return p;
+    contours.push_back(c);
+    saddles[idx(p)] = i;
+    return i;
 }
 
 /// Create a continuum with indexes of the inf and sup contour.
 /// Return an identifier (index in array) for the continuum.
-int CC::create_continuum(Pos inf, Pos sup, const DPoint& p) {
+int CC::create_continuum(int inf, int sup, Mme m) {
     int i=(int)continua.size();
     int j=root_contour(inf), k=root_contour(sup);
     if(contours[j].lvl > contours[k].lvl)
         std::swap(j,k);
     Continuum c(j,k);
-    c.mme.push_back(p);
+    c.mme.push_back(m);
+    if(! opt.topology)
+        c.attr = mme_attr(m);
     continua.push_back(c);
     return i;
 }
@@ -460,28 +805,51 @@ int CC::root_contour(int i) {
 int CC::adjacent_rect(const DPoint& p, Pos sep, int o) const {
     int oo=1-o;
     if((int)p[oo]==sep[oo] && (int)p[o]+1==sep[o] &&
-       (p[o]!=(int)p[o] || contours[idx(Pos((int)p.x,(int)p.y+h))].p.x<0))
+       (p[o]!=(int)p[o] || saddle((int)p.x,(int)p.y)<0))
         return -1; // p above sep
     if((int)p[oo]==sep[oo] && (int)p[o]==sep[o] && p[o]==(int)p[o])
         return 1; // p below sep
     return 0;
 }
 
-/// When two continua meeting along edge of top-left \a sep have mme
-/// \a v1 and \a v2, append v2 to \a v1. They may have to be reordered so that
-/// the edge is no longer a boundary. The orientation of the edge is given by
-/// o (0=vertical, 1=horizontal).
+/// Length of the edge shared by rectangles [p1,q1] and [p2,q2], 0 if none.
+static double shared_edge(const DPoint& p1, const DPoint& q1,
+                          const DPoint& p2, const DPoint& q2) {
+    double dx = std::min(q1.x,q2.x)-std::max(p1.x,p2.x);
+    double dy = std::min(q1.y,q2.y)-std::max(p1.y,p2.y);
+    if(dx==0 && dy>0)
+        return dy;
+    if(dy==0 && dx>0)
+        return dx;
+    return 0;
+}
+
+/// When two continua of indexes \a i1 and \a i2 meeting along edge of
+/// top-left \a sep have mme v1 and v2, append v2 to v1. They may have to be
+/// reordered so that the edge is no longer a boundary. The orientation of the
+/// edge is given by o (0=vertical, 1=horizontal). The attributes of v2 are
+/// added to the ones of \a i1, those of \a i2 are unchanged.
 /// Return iterator to the first element of junction.
-std::vector<DPoint>::iterator
-CC::merge_mme(std::vector<DPoint>& v1, std::vector<DPoint>& v2, Pos sep, int o) {
-    const DPoint& p = v1.front();
-    if(adjacent_rect(p, sep, o))
+std::vector<Mme>::iterator CC::merge_mme(int i1, int i2, Pos sep, int o) {
+    std::vector<Mme>& v1=continua[i1].mme, &v2=continua[i2].mme;
+    if(adjacent_rect(point(v1.front()), sep, o))
         reverse(v1.begin(), v1.end());
     int n = v1.size();
-    const DPoint& q = v2.back();
-    if(adjacent_rect(q, sep, o))
+    if(adjacent_rect(point(v2.back()), sep, o))
         reverse(v2.begin(), v2.end());
     v1.insert(v1.end(), v2.begin(), v2.end());
+    if(opt.topology)
+        return v1.begin()+n;
+
+    CCAttr& a1=continua[i1].attr;
+    const CCAttr& a2=continua[i2].attr;
+    DPoint p1=point(v1[n-1]), p2=point(v1[n]);
+    a1.chainLength += a2.chainLength -
+        2*shared_edge(p1,mme_br(p1), p2,mme_br(p2));
+    a1.area += a2.area;
+    a1.sumLvl += a2.sumLvl;
+    a1.tl.x = std::min(a1.tl.x,a2.tl.x); a1.tl.y = std::min(a1.tl.y,a2.tl.y);
+    a1.br.x = std::max(a1.br.x,a2.br.x); a1.br.y = std::max(a1.br.y,a2.br.y);
     return v1.begin()+n;
 }
 
@@ -10,6 +10,11 @@
 #define CC_H
 
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 template <typename T>
 struct Point {
@@ -32,36 +37,161 @@ struct Contour {
     Contour(): parent(-1), lvl(0) {}
 };
 
+/// Monotone mesh element, packed in 32 bits: index of the dual pixel (by its
+/// top-left corner) and two flags telling whether the x and y coordinates
+/// are the ones of the saddle of the dual pixel instead of the integer
+/// corner. Decoded by CC::point.
+struct Mme {
+    unsigned int code;
+    Mme(): code(0) {}
+    explicit Mme(int cell, bool saddleX=false, bool saddleY=false)
+    : code((unsigned int)cell<<2 | (saddleX? 2u: 0u) | (saddleY? 1u: 0u)) {}
+    int cell() const { return (int)(code>>2); }
+    bool saddleX() const { return (code&2) != 0; }
+    bool saddleY() const { return (code&1) != 0; }
+};
+
+/// Shape attributes of a continuum, additive over its mme so that they are
+/// combined in O(1) when mme lists are concatenated during propagation.
+struct CCAttr {
+    double area; ///< Total area of mme
+    double sumLvl; ///< Integral of the bilinear image over the mme
+    /// Length of the boundary of the chain of mme: sum of their perimeters
+    /// less twice the edges shared by consecutive mme. An edge shared by mme
+    /// not consecutive in the chain is counted, so this is not the perimeter
+    /// of the union, which can be smaller.
+    double chainLength;
+    DPoint tl, br; ///< Bounding box
+    CCAttr(): area(0), sumLvl(0), chainLength(0) {}
+    double mean() const { return area>0? sumLvl/area: 0; } ///< Mean level
+};
+
 struct Continuum {
     int parent; ///< Identify merges
     int infCtr, supCtr; ///< Inf and sup contour indexes
-    std::vector<DPoint> mme; ///< Monotone mesh elements
+    std::vector<Mme> mme; ///< Monotone mesh elements
+    CCAttr attr; ///< Attributes, maintained along mme
     Continuum(int inf, int sup): parent(-1), infCtr(inf), supCtr(sup) {}
 };
 
+/// Model of the image in a dual pixel whose diagonals are one below the
+/// other. Bilinear interpolation has a saddle point there. Digital
+/// connectivities have none: one diagonal pair is connected through the dual
+/// pixel, at its center, with no interpolated level and one continuum less.
+enum CCConnectivity {
+    CC_BILINEAR, ///< Saddle point, a virtual sample
+    CC_LOWER4, ///< Lower level sets 4-connected, upper ones 8-connected
+    CC_LOWER8 ///< Lower level sets 8-connected, upper ones 4-connected
+};
+
+/// Options of construction of C&C
+struct CCOptions {
+    bool keepFrame; ///< Keep chain codes of the frame, see CCTile
+    CCConnectivity connectivity; ///< Model in saddle configurations
+    /// Only contours and inf/sup contours of continua are wanted: mme are
+    /// released during construction and attributes are not computed
+    bool topology;
+    CCOptions(): keepFrame(false), connectivity(CC_BILINEAR),
+                 topology(false) {}
+};
+
+/// Status of construction of C&C
+enum CCStatus { CC_OK, CC_CANCELLED, CC_TIMEOUT };
+
+struct CC;
+struct Rect;
+struct CCTrace;
+
+/// Control of a construction from outside: cancellation, deadline,
+/// progress report and streaming of finalized continua. It is checked
+/// between levels of the pyramid of rectangles and periodically along the
+/// common edge of merged rectangles.
+struct CCContext {
+    std::atomic<bool> cancelled; ///< Set to true from any thread to abort
+    bool hasDeadline;
+    std::chrono::steady_clock::time_point deadline;
+    /// Called after each level of pyramid with level index and nb of levels
+    void (*progress)(int level, int nLevels, void* data);
+    /// Called once with each root continuum as soon as no later merge can
+    /// modify it, that is when it is absent from all the chain codes of the
+    /// current rectangles. Its mme and levels are final, the callback may
+    /// release its mme (partial in topology mode). Its contour indexes may
+    /// still be merged with other contours of same level.
+    void (*finalized)(CC& cc, int iContinuum, void* data);
+    void* data; ///< Passed to progress and finalized
+    CCTrace* trace; ///< Timeline of construction if not null, see trace.h
+    /// File where the state is saved at the end of levels of the pyramid,
+    /// for CC::resume, if not empty
+    std::string checkpoint;
+    double checkpointPeriod; ///< Min seconds between checkpoints
+    CCContext(): cancelled(false), hasDeadline(false), progress(0),
+                 finalized(0), data(0), trace(0), checkpointPeriod(0) {}
+    void set_timeout(double ms);
+    CCStatus check() const;
+};
+
 /// Contours and continua
 struct CC {
-    Contour* contours;
+    /// Pixels, then saddles in creation order (any order if sparse)
+    std::vector<Contour> contours;
+    /// Contour index of saddle of each dual pixel, empty if sparse
+    std::vector<int> saddles;
+    /// Contour index of saddle of dual pixels if sparse
+    std::unordered_map<int,int> sparseSaddles;
     std::vector<Continuum> continua;
     int w,h;
-    CC(const float* im, int w, int h);
+    CCOptions opt;
+    CCStatus status; ///< Not CC_OK if construction was interrupted
+    std::unique_ptr<Rect> frame; ///< Chain codes of frame if opt.keepFrame
+    /// T is float, unsigned char or unsigned short. Samples are invalid where
+    /// \a mask is 0, if not null, or NaN: their contour has level NaN and
+    /// dual pixels touching them are outside the domain, with no continuum.
+    template <typename T>
+    CC(const T* im, int w, int h, const CCOptions& opt=CCOptions(),
+       CCContext* ctx=0, const unsigned char* mask=0);
+    CC(int w, int h, const CCOptions& opt=CCOptions(), CCContext* ctx=0,
+       bool dense=true);
+    static CC* resume(const std::string& checkpoint, CCContext* ctx=0);
+    ~CC();
+    CC(const CC&) = delete;
+    CC& operator=(const CC&) = delete;
 
     int idx(int x, int y) const { return y*w+x; }
     int idx(Pos p) const { return idx(p.x,p.y); }
+    DPoint point(Mme m) const;
     DPoint mme_br(const DPoint& p) const;
 
-    Pos create_saddle(Pos p, float lvl[4]);
-    int create_continuum(Pos inf, Pos sup, const DPoint& p);
+    int saddle(int x, int y) const { return saddle(idx(x,y)); }
+    int saddle(int i) const {
+        return saddles.empty()? sparse_saddle(i): saddles[i];
+    }
+    int sparse_saddle(int i) const;
+    int create_saddle(Pos p, float lvl[4]);
+    int create_continuum(int inf, int sup, Mme m);
+    int create_continuum(Pos inf, Pos sup, Mme m) {
+        return create_continuum(idx(inf), idx(sup), m);
+    }
 
     void merge_contours(Pos c1, Pos c2);
     int root_contour(int i);
     int root_contour(Pos c) { return root_contour(idx(c)); }
 
-    std::vector<DPoint>::iterator
-    merge_mme(std::vector<DPoint>& v1, std::vector<DPoint>& v2,
-              Pos sep, int o);
+    CCAttr mme_attr(Mme m) const;
+    std::vector<Mme>::iterator merge_mme(int i1, int i2, Pos sep, int o);
     int root_continuum(int i);
+    bool interrupted(bool force=false);
+    CCTrace* trace() const { return ctx? ctx->trace: 0; }
 private:
+    CCContext* ctx;
+    unsigned int ticks; ///< Calls to interrupted() since last check
+    void build();
+    template <typename I> bool build_leaves(std::vector<Rect>& R);
+    void build_pyramid(std::vector<Rect>& R, std::vector<bool>& done,
+                       int level, int w2, int h2);
+    bool save_checkpoint(const std::string& fileName,
+                         const std::vector<Rect>& R,
+                         const std::vector<bool>& done,
+                         int level, int w2, int h2) const;
     int adjacent_rect(const DPoint& p, Pos sep, int o) const;
 };
 
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file ccapi.cpp
+ * @brief C interface of library shapevision
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "ccapi.h"
+#include "cc.h"
+#include <new>
+#include <cstddef>
+
+struct cc_handle {
+    CC cc;
+    template <typename T>
+    cc_handle(const T* im, int w, int h, const CCOptions& opt)
+    : cc(im, w, h, opt) {}
+};
+
+/**
+ * @brief build contours & continua of an image
+ *
+ * @param data buffer of w*h samples, row by row, of type given by sample
+ * @param w, h dimensions of image, at most 32767
+ * @param sample type of samples (enum cc_sample)
+ * @return handle to destroy with cc_destroy(), or NULL if an error happens
+ */
+cc_handle *cc_create(const void *data, int w, int h, int sample)
+{
+    if (NULL == data || w <= 0 || h <= 0 || w > 32767 || h > 32767)
+        return NULL;
+    CCOptions opt;
+    try {
+        switch (sample) {
+        case CC_F32:
+            return new cc_handle((const float *) data, w, h, opt);
+        case CC_U8:
+            return new cc_handle((const unsigned char *) data, w, h, opt);
+        case CC_U16:
+            return new cc_handle((const unsigned short *) data, w, h, opt);
+        }
+    } catch(const std::bad_alloc &) {}
+    return NULL;
+}
+
+/** @brief free memory of handle, ignored if NULL */
+void cc_destroy(cc_handle *cc)
+{
+    delete cc;
+}
+
+int cc_width(const cc_handle *cc)
+{
+    return cc->cc.w;
+}
+
+int cc_height(const cc_handle *cc)
+{
+    return cc->cc.h;
+}
+
+/** @brief number of contours: pixels, then virtual saddles */
+int cc_num_contours(const cc_handle *cc)
+{
+    return (int) cc->cc.contours.size();
+}
+
+float cc_contour_level(const cc_handle *cc, int i)
+{
+    return cc->cc.contours[i].lvl;
+}
+
+/** @brief canonical contour of contour i, without path compression */
+int cc_root_contour(const cc_handle *cc, int i)
+{
+    while (cc->cc.contours[i].parent >= 0)
+        i = cc->cc.contours[i].parent;
+    return i;
+}
+
+int cc_num_continua(const cc_handle *cc)
+{
+    return (int) cc->cc.continua.size();
+}
+
+/**
+ * @brief inf and sup contours and merge parent of continuum i
+ *
+ * @param inf, sup, parent pointers to variables to fill, ignored if NULL
+ * @return 0 if everything OK, -1 if i is out of range
+ */
+int cc_continuum(const cc_handle *cc, int i, int *inf, int *sup, int *parent)
+{
+    if (i < 0 || i >= (int) cc->cc.continua.size())
+        return -1;
+    const Continuum &c = cc->cc.continua[i];
+    if (inf)
+        *inf = c.infCtr;
+    if (sup)
+        *sup = c.supCtr;
+    if (parent)
+        *parent = c.parent;
+    return 0;
+}
+
+/** @brief canonical continuum of continuum i, without path compression */
+int cc_root_continuum(const cc_handle *cc, int i)
+{
+    while (cc->cc.continua[i].parent >= 0)
+        i = cc->cc.continua[i].parent;
+    return i;
+}
+
+/**
+ * @brief monotone mesh elements of continuum i
+ *
+ * @param codes filled with pointer to the packed mme, owned by the handle
+ * @return number of mme, -1 if i is out of range
+ */
+int cc_mme(const cc_handle *cc, int i, const unsigned int **codes)
+{
+    if (i < 0 || i >= (int) cc->cc.continua.size())
+        return -1;
+    const std::vector<Mme> &mme = cc->cc.continua[i].mme;
+    *codes = mme.empty() ? NULL : &mme[0].code;
+    return (int) mme.size();
+}
+
+/**
+ * @brief top-left corner (x,y) of a packed mme given by cc_mme
+ */
+void cc_mme_point(const cc_handle *cc, unsigned int code, double *x, double *y)
+{
+    Mme m;
+    m.code = code;
+    DPoint p = cc->cc.point(m);
+    *x = p.x;
+    *y = p.y;
+}
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+/**
+ * @file ccapi.h
+ * @brief C interface of library shapevision
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * The library has no global state: distinct handles can be created, queried
+ * and destroyed concurrently from different threads. Queries do not modify
+ * the handle, so a handle can also be queried from several threads.
+ */
+
+#ifndef CCAPI_H
+#define CCAPI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque handle to contours & continua of an image */
+typedef struct cc_handle cc_handle;
+
+/** Type of samples of the input buffer */
+enum cc_sample { CC_F32=0, CC_U8=1, CC_U16=2 };
+
+cc_handle *cc_create(const void *data, int w, int h, int sample);
+void cc_destroy(cc_handle *cc);
+
+int cc_width(const cc_handle *cc);
+int cc_height(const cc_handle *cc);
+int cc_num_contours(const cc_handle *cc);
+float cc_contour_level(const cc_handle *cc, int i);
+int cc_root_contour(const cc_handle *cc, int i);
+int cc_num_continua(const cc_handle *cc);
+int cc_continuum(const cc_handle *cc, int i, int *inf, int *sup, int *parent);
+int cc_root_continuum(const cc_handle *cc, int i);
+int cc_mme(const cc_handle *cc, int i, const unsigned int **codes);
+void cc_mme_point(const cc_handle *cc, unsigned int code, double *x, double *y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
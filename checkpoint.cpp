@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file checkpoint.cpp
+ * @brief Checkpoint and resume of the construction of contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * The state between two levels of the pyramid is saved in a portable
+ * binary format, little-endian:
+ * - "CCK2", then w, h, connectivity, keepFrame, topology, the next level,
+ *   the width and height of the array of rectangles as int32;
+ * - number of contours, then for each one its parent as int32, its level
+ *   as float32 and its position as two float64;
+ * - number of saddles, then for each one its dual pixel and contour as
+ *   uint32;
+ * - number of continua, then for each one its parent, inf and sup contours
+ *   as int32, its attributes (area, sumLvl, chainLength, tl, br) as 7
+ *   float64, its number of mme and their codes as uint32;
+ * - number of continua already reported as finalized, and their indexes;
+ * - the rectangles by rows: tl and br as int32, then for each of the 4
+ *   sides, the number of edges, then for each edge the length of its
+ *   chain code and its indexes as uint32. Sides and chain codes outside the
+ *   domain of a masked image are empty.
+ */
+
+#include "cc.h"
+#include "rect.h"
+#include "binio.h"
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+/// Write the state of construction in file \a fileName: the array \a R of
+/// \a w2 x \a h2 rectangles to merge from level \a level, and the continua
+/// marked in \a done as reported. The file is replaced only once complete.
+/// Return whether it succeeded.
+bool CC::save_checkpoint(const std::string& fileName,
+                         const std::vector<Rect>& R,
+                         const std::vector<bool>& done,
+                         int level, int w2, int h2) const {
+    const std::string tmp = fileName + ".tmp";
+    std::ofstream s(tmp.c_str(), std::ios::binary);
+    s.write("CCK2", 4);
+    const int head[] = {w, h, (int)opt.connectivity, opt.keepFrame,
+                        opt.topology};
+    for(int v: head)
+        put32(s, (uint32_t)v);
+    const int pyr[] = {level, w2, h2};
+    for(int v: pyr)
+        put32(s, (uint32_t)v);
+    put32(s, (uint32_t)contours.size());
+    for(const Contour& c: contours) {
+        put32(s, (uint32_t)c.parent);
+        put_float(s, c.lvl);
+        put_double(s, c.p.x);
+        put_double(s, c.p.y);
+    }
+    put32(s, (uint32_t)(contours.size()-(size_t)w*h));
+    for(size_t i=0; i<saddles.size(); i++)
+        if(saddles[i] >= 0) {
+            put32(s, (uint32_t)i);
+            put32(s, (uint32_t)saddles[i]);
+        }
+    put32(s, (uint32_t)continua.size());
+    for(const Continuum& c: continua) {
+        put32(s, (uint32_t)c.parent);
+        put32(s, (uint32_t)c.infCtr);
+        put32(s, (uint32_t)c.supCtr);
+        const double attr[] = {c.attr.area, c.attr.sumLvl,
+                               c.attr.chainLength, c.attr.tl.x, c.attr.tl.y,
+                               c.attr.br.x, c.attr.br.y};
+        for(double v: attr)
+            put_double(s, v);
+        put32(s, (uint32_t)c.mme.size());
+        for(const Mme& m: c.mme)
+            put32(s, m.code);
+    }
+    uint32_t nDone=0;
+    for(bool b: done)
+        nDone += b;
+    put32(s, nDone);
+    for(size_t i=0; i<done.size(); i++)
+        if(done[i])
+            put32(s, (uint32_t)i);
+    for(const Rect& r: R) {
+        const int corners[] = {r.tl.x, r.tl.y, r.br.x, r.br.y};
+        for(int v: corners)
+            put32(s, (uint32_t)v);
+        for(int i=0; i<4; i++) {
+            put32(s, (uint32_t)r.chainCode[i].size());
+            for(const std::list<int>& L: r.chainCode[i]) {
+                put32(s, (uint32_t)L.size());
+                for(int v: L)
+                    put32(s, (uint32_t)v);
+            }
+        }
+    }
+    s.close();
+    if(!s || std::rename(tmp.c_str(), fileName.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+/// Read in \a s the rectangle of \a cc at \a p in the array of rectangles
+/// of \a size dual pixels (less at the end of rows and columns). The stream
+/// fails if the rectangle is inconsistent.
+static Rect load_rect(std::istream& s, const CC& cc, Pos p, int size) {
+    int c[4];
+    for(int& v: c)
+        v = (int)get32(s);
+    Rect R(Pos(c[0],c[1]), Pos(c[2],c[3]));
+    if(c[0]!=p.x*size || c[1]!=p.y*size || c[2]!=std::min(c[0]+size,cc.w-1)
+       || c[3]!=std::min(c[1]+size,cc.h-1))
+        s.setstate(std::ios::failbit);
+    const uint32_t nCtr=(uint32_t)cc.contours.size(),
+        nCtn=(uint32_t)cc.continua.size();
+    for(int i=0; i<4 && s; i++) {
+        const uint32_t len = (i&1)? R.br.y-R.tl.y: R.br.x-R.tl.x;
+        const uint32_t nEdges = get32(s); // 0 if side outside domain
+        if(nEdges != len && nEdges != 0)
+            s.setstate(std::ios::failbit);
+        for(uint32_t j=0; j<nEdges && s; j++) {
+            std::list<int> L;
+            for(uint32_t k=get32(s); s && L.size()<k; ) {
+                uint32_t v = get32(s);
+                if(v >= ((L.size()&1)? nCtn: nCtr))
+                    s.setstate(std::ios::failbit);
+                L.push_back((int)v);
+            }
+            if(!L.empty() && !(L.size()&1)) // Starts and ends with a contour
+                s.setstate(std::ios::failbit);
+            R.chainCode[i].push_back(std::move(L));
+        }
+    }
+    return R;
+}
+
+/// Resume the construction saved in file \a fileName by a checkpoint, with
+/// context \a ctx. Return 0 if the file cannot be read or is inconsistent,
+/// otherwise the C&C, whose status tells whether it was interrupted again.
+CC* CC::resume(const std::string& fileName, CCContext* ctx) {
+    std::ifstream s(fileName.c_str(), std::ios::binary);
+    char magic[4] = {0,0,0,0};
+    s.read(magic, 4);
+    if(std::memcmp(magic, "CCK2", 4) != 0)
+        return 0;
+    int head[8];
+    for(int& v: head)
+        v = (int)get32(s);
+    CCOptions opt;
+    const int w=head[0], h=head[1], level=head[5], w2=head[6], h2=head[7];
+    if(!s || w<2 || h<2 || w>32767 || h>32767 || head[2]<CC_BILINEAR ||
+       head[2]>CC_LOWER8 || level<2 || level>16)
+        return 0;
+    const int size = 1<<(level-1); // Of rectangles, in dual pixels
+    if(w2 != (w-2)/size+1 || h2 != (h-2)/size+1 || (w2==1 && h2==1))
+        return 0;
+    opt.connectivity = (CCConnectivity)head[2];
+    opt.keepFrame = (head[3] != 0);
+    opt.topology = (head[4] != 0);
+    std::unique_ptr<CC> cc(new CC(w, h, opt, ctx));
+
+    const uint32_t n = get32(s);
+    if(n < (uint32_t)w*h)
+        return 0;
+    cc->contours.clear();
+    for(uint32_t i=0; i<n && s; i++) {
+        Contour c;
+        c.parent = (int)get32(s);
+        c.lvl = get_float(s);
+        c.p.x = get_double(s);
+        c.p.y = get_double(s);
+        if(c.parent<-1 || c.parent>=(int)n)
+            s.setstate(std::ios::failbit);
+        cc->contours.push_back(c);
+    }
+    if(get32(s) != n-(uint32_t)w*h)
+        return 0;
+    for(uint32_t i=(uint32_t)w*h; i<n && s; i++) {
+        uint32_t cell=get32(s), j=get32(s);
+        if(cell>=(uint32_t)w*h || j<(uint32_t)w*h || j>=n)
+            return 0;
+        cc->saddles[cell] = (int)j;
+    }
+    for(uint32_t k=get32(s); s && cc->continua.size()<k; ) {
+        Continuum c(0,0);
+        c.parent = (int)get32(s);
+        c.infCtr = (int)get32(s);
+        c.supCtr = (int)get32(s);
+        double* attr[] = {&c.attr.area, &c.attr.sumLvl, &c.attr.chainLength,
+                          &c.attr.tl.x, &c.attr.tl.y, &c.attr.br.x,
+                          &c.attr.br.y};
+        for(double* v: attr)
+            *v = get_double(s);
+        for(uint32_t m=get32(s); s && c.mme.size()<m; ) {
+            Mme mme;
+            mme.code = get32(s);
+            if(mme.cell() >= w*h)
+                s.setstate(std::ios::failbit);
+            c.mme.push_back(mme);
+        }
+        if(c.parent<-1 || c.parent>=(int)k ||
+           (uint32_t)c.infCtr>=n || (uint32_t)c.supCtr>=n)
+            s.setstate(std::ios::failbit);
+        cc->continua.push_back(std::move(c));
+    }
+    std::vector<bool> done(cc->continua.size(), false);
+    for(uint32_t k=get32(s), i=0; s && i<k; i++) {
+        uint32_t j = get32(s);
+        if(j >= done.size())
+            return 0;
+        done[j] = true;
+    }
+    std::vector<Rect> R;
+    for(int i=0; i<h2 && s; i++)
+        for(int j=0; j<w2 && s; j++)
+            R.push_back(load_rect(s, *cc, Pos(j,i), size));
+    if(! s)
+        return 0;
+    cc->build_pyramid(R, done, level, w2, h2);
+    return cc.release();
+}
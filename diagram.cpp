@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file diagram.cpp
+ * @brief Persistence diagrams of contours & continua and their distances
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "diagram.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+static const double INF = 1e300;
+
+/// Diagram of the root continua of \a cc, in one pass. Only points of
+/// persistence (sup-inf) at least \a minPers are kept.
+PDiagram persistence_diagram(const CC& cc, float minPers) {
+    PDiagram d;
+    for(size_t i=0; i<cc.continua.size(); i++) {
+        const Continuum& c = cc.continua[i];
+        if(c.parent >= 0)
+            continue;
+        // Merged contours have same level, no need of the canonical one
+        PDPoint p(cc.contours[c.infCtr].lvl, cc.contours[c.supCtr].lvl);
+        if(p.death-p.birth >= minPers)
+            d.push_back(p);
+    }
+    return d;
+}
+
+static double linf(const PDPoint& a, const PDPoint& b) {
+    return std::max(std::abs(a.birth-b.birth), std::abs(a.death-b.death));
+}
+
+/// Distance to diagonal
+static double diag(const PDPoint& a) {
+    return std::abs(a.death-a.birth)/2;
+}
+
+static double power(double x, double q) {
+    return (q==1)? x: (q==2)? x*x: std::pow(x,q);
+}
+
+/// Matching of diagrams as an assignment problem of size n+m. Rows are the
+/// points of \a a then the diagonal copies of points of \a b, columns are
+/// the points of \a b then the diagonal copies of points of \a a.
+struct Assignment {
+    const PDiagram &a, &b;
+    int n, m;
+    double q;
+    Assignment(const PDiagram& a, const PDiagram& b, double q)
+    : a(a), b(b), n((int)a.size()), m((int)b.size()), q(q) {}
+    int size() const { return n+m; }
+    double cost(int i, int j) const {
+        if(i < n) {
+            if(j < m)
+                return power(linf(a[i],b[j]), q);
+            return (j-m==i)? power(diag(a[i]), q): INF;
+        }
+        if(j < m)
+            return (j==i-n)? power(diag(b[j]), q): INF;
+        return 0;
+    }
+    double max_cost() const;
+    double hungarian() const;
+    double auction(double relErr) const;
+};
+
+/// Max finite cost, bound of the price of an object in auction.
+double Assignment::max_cost() const {
+    double c=0;
+    for(int i=0; i<n; i++) {
+        for(int j=0; j<m; j++)
+            c = std::max(c, cost(i,j));
+        c = std::max(c, cost(i,m+i));
+    }
+    for(int j=0; j<m; j++)
+        c = std::max(c, cost(n+j,j));
+    return c;
+}
+
+/// Optimal cost by the Hungarian algorithm with potentials, O((n+m)^3).
+double Assignment::hungarian() const {
+    const int N = size();
+    std::vector<double> u(N+1,0), v(N+1,0), minv(N+1);
+    std::vector<int> p(N+1,0), way(N+1,0); // p[j]: row of column j (1-based)
+    std::vector<bool> used(N+1);
+    for(int i=1; i<=N; i++) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), INF);
+        std::fill(used.begin(), used.end(), false);
+        do {
+            used[j0] = true;
+            int i0=p[j0], j1=0;
+            double delta = INF;
+            for(int j=1; j<=N; j++)
+                if(! used[j]) {
+                    double cur = cost(i0-1,j-1)-u[i0]-v[j];
+                    if(cur < minv[j]) {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if(minv[j] < delta) {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+            for(int j=0; j<=N; j++)
+                if(used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else
+                    minv[j] -= delta;
+            j0 = j1;
+        } while(p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while(j0);
+    }
+    double c=0;
+    for(int j=1; j<=N; j++)
+        c += cost(p[j]-1, j-1);
+    return c;
+}
+
+/// Approximate cost by auction with epsilon scaling. A phase ends with an
+/// assignment within N*eps of the optimum, so we stop early as soon as this
+/// bound is below \a relErr times the cost.
+double Assignment::auction(double relErr) const {
+    const int N = size();
+    const double cMax = max_cost();
+    if(cMax == 0)
+        return 0;
+    std::vector<double> price(N,0);
+    std::vector<int> owner(N), object(N);
+    double total=0;
+    for(double eps=cMax/4; ; eps/=5) {
+        std::fill(owner.begin(), owner.end(), -1);
+        std::fill(object.begin(), object.end(), -1);
+        std::vector<int> free;
+        for(int i=N-1; i>=0; i--)
+            free.push_back(i);
+        while(! free.empty()) {
+            int i = free.back();
+            free.pop_back();
+            // Best and second best objects of i: min of cost+price
+            double best=INF, second=INF;
+            int jBest=-1;
+            auto bid = [&](int j) {
+                double c = cost(i,j)+price[j];
+                if(c < best) {
+                    second = best;
+                    best = c;
+                    jBest = j;
+                } else if(c < second)
+                    second = c;
+            };
+            if(i < n) {
+                for(int j=0; j<m; j++)
+                    bid(j);
+                bid(m+i);
+            } else {
+                bid(i-n);
+                for(int j=m; j<N; j++)
+                    bid(j);
+            }
+            price[jBest] += (second-best)+eps;
+            if(owner[jBest] >= 0) {
+                object[owner[jBest]] = -1;
+                free.push_back(owner[jBest]);
+            }
+            owner[jBest] = i;
+            object[i] = jBest;
+        }
+        total = 0;
+        for(int i=0; i<N; i++)
+            total += cost(i, object[i]);
+        if(N*eps <= relErr*total || eps < cMax*1e-12)
+            break;
+    }
+    return total;
+}
+
+/// Points of \a L indexed by \a rows must be matched to points of \a R at
+/// distance at most \a t. Check it by Hopcroft-Karp maximum matching.
+struct Saturation {
+    const PDiagram &L, &R;
+    const std::vector<int>& rows;
+    double t;
+    std::vector<int> matchL, matchR, dist;
+    Saturation(const PDiagram& L, const PDiagram& R,
+               const std::vector<int>& rows, double t)
+    : L(L), R(R), rows(rows), t(t),
+      matchL(rows.size(),-1), matchR(R.size(),-1), dist(rows.size()) {}
+    bool edge(int u, int r) const { return linf(L[rows[u]],R[r]) <= t; }
+    bool bfs();
+    bool dfs(int u);
+    bool run();
+};
+
+/// Layers of alternating paths from free rows. Return whether a free column
+/// is reachable.
+bool Saturation::bfs() {
+    std::vector<int> queue;
+    for(size_t u=0; u<rows.size(); u++) {
+        dist[u] = (matchL[u]<0)? 0: -1;
+        if(matchL[u] < 0)
+            queue.push_back((int)u);
+    }
+    bool found = false;
+    for(size_t k=0; k<queue.size(); k++) {
+        int u = queue[k];
+        for(int r=0; r<(int)R.size(); r++)
+            if(edge(u,r)) {
+                int w = matchR[r];
+                if(w < 0)
+                    found = true;
+                else if(dist[w] < 0) {
+                    dist[w] = dist[u]+1;
+                    queue.push_back(w);
+                }
+            }
+    }
+    return found;
+}
+
+bool Saturation::dfs(int u) {
+    for(int r=0; r<(int)R.size(); r++)
+        if(edge(u,r)) {
+            int w = matchR[r];
+            if(w<0 || (dist[w]==dist[u]+1 && dfs(w))) {
+                matchL[u] = r;
+                matchR[r] = u;
+                return true;
+            }
+        }
+    dist[u] = -1;
+    return false;
+}
+
+bool Saturation::run() {
+    if(rows.size() > R.size())
+        return false;
+    size_t size=0;
+    while(bfs())
+        for(size_t u=0; u<rows.size(); u++)
+            if(matchL[u]<0 && dfs((int)u))
+                ++size;
+    return size == rows.size();
+}
+
+/// Is there a matching of \a a and \a b (points possibly matched to the
+/// diagonal) with all distances at most \a t? Points farther than \a t from
+/// the diagonal must be matched to points of the other diagram. Matchings
+/// saturating those of \a a and those of \a b exist separately if and only
+/// if one saturates both (Mendelsohn-Dulmage).
+static bool feasible(const PDiagram& a, const PDiagram& b, double t) {
+    std::vector<int> sa, sb;
+    for(size_t i=0; i<a.size(); i++)
+        if(diag(a[i]) > t)
+            sa.push_back((int)i);
+    for(size_t j=0; j<b.size(); j++)
+        if(diag(b[j]) > t)
+            sb.push_back((int)j);
+    return Saturation(a,b,sa,t).run() && Saturation(b,a,sb,t).run();
+}
+
+/// Bottleneck distance: binary search of the threshold among the candidate
+/// distances if exact, among reals up to relative error \a relErr otherwise.
+static double bottleneck(const PDiagram& a, const PDiagram& b, bool exact,
+                         double relErr) {
+    double hi=0; // All points to diagonal
+    for(size_t i=0; i<a.size(); i++)
+        hi = std::max(hi, diag(a[i]));
+    for(size_t j=0; j<b.size(); j++)
+        hi = std::max(hi, diag(b[j]));
+    if(! exact) {
+        double lo=0;
+        while(hi-lo > relErr*hi) {
+            double t = (lo+hi)/2;
+            if(feasible(a,b,t))
+                hi = t;
+            else
+                lo = t;
+        }
+        return hi;
+    }
+    std::vector<double> c(1,0.0);
+    for(size_t i=0; i<a.size(); i++) {
+        c.push_back(diag(a[i]));
+        for(size_t j=0; j<b.size(); j++)
+            c.push_back(linf(a[i],b[j]));
+    }
+    for(size_t j=0; j<b.size(); j++)
+        c.push_back(diag(b[j]));
+    std::sort(c.begin(), c.end());
+    c.erase(std::unique(c.begin(),c.end()), c.end());
+    c.erase(std::upper_bound(c.begin(),c.end(),hi), c.end());
+    size_t lo=0, up=c.size()-1; // c[up] feasible
+    while(lo < up) {
+        size_t mid = (lo+up)/2;
+        if(feasible(a,b,c[mid]))
+            up = mid;
+        else
+            lo = mid+1;
+    }
+    return c[up];
+}
+
+/// Wasserstein distance of exponent opt.q between diagrams \a a and \a b,
+/// or bottleneck distance if opt.q is 0.
+double pd_distance(const PDiagram& a, const PDiagram& b,
+                   const PDOptions& opt) {
+    if(opt.q <= 0)
+        return bottleneck(a, b, opt.exact, opt.relErr);
+    Assignment A(a, b, opt.q);
+    double c=0;
+    if(a.empty() || b.empty()) { // All points to diagonal
+        for(size_t i=0; i<a.size(); i++)
+            c += power(diag(a[i]), opt.q);
+        for(size_t j=0; j<b.size(); j++)
+            c += power(diag(b[j]), opt.q);
+    } else
+        c = opt.exact? A.hungarian(): A.auction(opt.relErr);
+    return (opt.q==1)? c: std::pow(c, 1/opt.q);
+}
+
+/// Distances of \a query to each diagram of \a db, computed by \a nThreads
+/// threads (0=number of cores).
+std::vector<double> pd_distances(const PDiagram& query,
+                                 const std::vector<PDiagram>& db,
+                                 const PDOptions& opt, int nThreads) {
+    const int k = (int)db.size();
+    std::vector<double> d(k);
+    if(nThreads <= 0)
+        nThreads = (int)std::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads,k));
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for(int i=next++; i<k; i=next++)
+            d[i] = pd_distance(query, db[i], opt);
+    };
+    std::vector<std::thread> threads;
+    for(int t=1; t<nThreads; t++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for(size_t t=0; t<threads.size(); t++)
+        threads[t].join();
+    return d;
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file diagram.h
+ * @brief Persistence diagrams of contours & continua and their distances
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef DIAGRAM_H
+#define DIAGRAM_H
+
+#include "cc.h"
+#include <vector>
+
+/// Point of persistence diagram: inf and sup levels of a shape.
+struct PDPoint {
+    float birth, death;
+    PDPoint(float b=0, float d=0): birth(b), death(d) {}
+};
+typedef std::vector<PDPoint> PDiagram;
+
+PDiagram persistence_diagram(const CC& cc, float minPers=0);
+
+/// Options of distance between diagrams. The ground distance of points is
+/// L-infinity, a point may be matched to its projection on the diagonal.
+struct PDOptions {
+    double q; ///< Exponent of Wasserstein distance, 0 for bottleneck
+    bool exact; ///< Exact or approximate (auction, binary search)
+    double relErr; ///< Relative error allowed by approximation
+    PDOptions(): q(1), exact(true), relErr(0.01) {}
+};
+
+double pd_distance(const PDiagram& a, const PDiagram& b,
+                   const PDOptions& opt=PDOptions());
+std::vector<double> pd_distances(const PDiagram& query,
+                                 const std::vector<PDiagram>& db,
+                                 const PDOptions& opt=PDOptions(),
+                                 int nThreads=0);
+
+#endif
@@ -25,6 +25,8 @@
  * This is a front-end to libpng, with routines to:
  * @li read a PNG file as a de-interlaced 8bit integer or float array
  * @li write a 8bit integer or float array to a PNG file
+ * @li write a float array to a 16bit PNG file, with configurable
+ *     compression and strip-parallel deflate
  *
  * Multi-channel images are handled: gray, gray+alpha, rgb and
  * rgb+alpha, as well as on-the-fly color model conversion.
@@ -43,6 +45,7 @@
 #include <string.h>
 #include <math.h>
 #include <limits.h>
+#include <zlib.h>
 
 /* option to use a local version of the libpng */
 #ifdef IO_PNG_LOCAL_LIBPNG
@@ -59,6 +62,8 @@
 /* internal only data type identifiers */
 #define IO_PNG_U8  0x0001       /*  8bit unsigned integer */
 #define IO_PNG_F32 0x0002       /* 32bit float */
+#define IO_PNG_F32_GRAY 0x0003  /* 32bit float, converted to gray */
+#define IO_PNG_F32_PLANAR 0x0004 /* 32bit float, planar, 16bit kept */
 
 /*
  * INFO
@@ -107,6 +112,159 @@ static void _io_png_err_hdl(png_structp png_ptr, png_const_charp msg)
     longjmp(err_ptr->jmpbuf, 1);
 }
 
+/*
+ * CONVERSION KERNELS
+ */
+
+/*
+ * Conversion of one row of interleaved samples to float, extracting one
+ * channel (stride = number of channels) or combining RGB to gray.
+ * 16bit samples are big-endian, as stored in PNG. The AVX2 versions are
+ * selected at runtime when the CPU supports them; they give exactly the
+ * same results as the scalar versions.
+ */
+typedef void (*_io_png_kernel_t) (const png_byte * src, size_t stride,
+                                  float *dst, size_t n);
+
+/** @brief channel of 8bit samples to float, scalar version */
+static void _io_png_u8_f32(const png_byte * src, size_t stride,
+                           float *dst, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; i++, src += stride)
+        dst[i] = (float) *src;
+}
+
+/** @brief channel of 16bit samples to float, scalar version */
+static void _io_png_u16_f32(const png_byte * src, size_t stride,
+                            float *dst, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; i++, src += 2 * stride)
+        dst[i] = (float) ((src[0] << 8) | src[1]);
+}
+
+/** @brief 8bit RGB samples (stride 3 or 4) to gray, scalar version */
+static void _io_png_gray_f32(const png_byte * src, size_t stride,
+                             float *dst, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; i++, src += stride)
+        dst[i] = rgb_to_gray((float) src[0], (float) src[1], (float) src[2]);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define IO_PNG_AVX2 __attribute__((target("avx2")))
+
+/** @brief 8 offsets i*stride, i=0..7 */
+IO_PNG_AVX2 static __m256i _io_png_offsets(size_t stride)
+{
+    return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                              _mm256_set1_epi32((int) stride));
+}
+
+/*
+ * Gathers read 4 bytes at each offset: the vector loops stop early enough
+ * not to read past the last sample, the scalar version finishes the row.
+ */
+
+IO_PNG_AVX2 static void _io_png_u8_f32_avx2(const png_byte * src,
+                                            size_t stride, float *dst,
+                                            size_t n)
+{
+    size_t i = 0;
+    if (1 == stride)
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadl_epi64((const __m128i *) (src + i));
+            _mm256_storeu_ps(dst + i,
+                             _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)));
+    } else {
+        const __m256i off = _io_png_offsets(stride);
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        for (; i + 8 + 4 / stride <= n; i += 8) {
+            __m256i v = _mm256_i32gather_epi32((const int *)
+                                               (src + i * stride), off, 1);
+            v = _mm256_and_si256(v, mask);
+            _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+        }
+    }
+    _io_png_u8_f32(src + i * stride, stride, dst + i, n - i);
+}
+
+IO_PNG_AVX2 static void _io_png_u16_f32_avx2(const png_byte * src,
+                                             size_t stride, float *dst,
+                                             size_t n)
+{
+    size_t i = 0;
+    const __m256i off = _io_png_offsets(2 * stride);
+    const __m256i lo = _mm256_set1_epi32(0xff);
+    for (; i + 9 <= n; i += 8) {
+        __m256i v = _mm256_i32gather_epi32((const int *)
+                                           (src + 2 * i * stride), off, 1);
+        /* bytes b0 b1 (big-endian) are the 2 low bytes of little-endian v */
+        v = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(v, lo), 8),
+                            _mm256_and_si256(_mm256_srli_epi32(v, 8), lo));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+    }
+    _io_png_u16_f32(src + 2 * i * stride, stride, dst + i, n - i);
+}
+
+IO_PNG_AVX2 static void _io_png_gray_f32_avx2(const png_byte * src,
+                                              size_t stride, float *dst,
+                                              size_t n)
+{
+    size_t i = 0;
+    const __m256i off = _io_png_offsets(stride);
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256 cr = _mm256_set1_ps(6969), cg = _mm256_set1_ps(23434);
+    const __m256 cb = _mm256_set1_ps(2365);
+    const __m256 norm = _mm256_set1_ps(1.f / 32768);
+    for (; i + 9 <= n; i += 8) {
+        const int *p = (const int *) (src + i * stride);
+        __m256 r = _mm256_cvtepi32_ps(_mm256_and_si256
+                                      (_mm256_i32gather_epi32(p, off, 1),
+                                       mask));
+        __m256 g = _mm256_cvtepi32_ps(_mm256_and_si256
+                                      (_mm256_i32gather_epi32
+                                       ((const int *) ((const png_byte *) p +
+                                                       1), off, 1), mask));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256
+                                      (_mm256_i32gather_epi32
+                                       ((const int *) ((const png_byte *) p +
+                                                       2), off, 1), mask));
+        /* same operations and order as rgb_to_gray(), no FMA */
+        __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cr, r),
+                                               _mm256_mul_ps(cg, g)),
+                                 _mm256_mul_ps(cb, b));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(y, norm));
+    }
+    _io_png_gray_f32(src + i * stride, stride, dst + i, n - i);
+}
+#endif
+
+static _io_png_kernel_t _io_png_kernel_u8 = _io_png_u8_f32;
+static _io_png_kernel_t _io_png_kernel_u16 = _io_png_u16_f32;
+static _io_png_kernel_t _io_png_kernel_gray = _io_png_gray_f32;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/**
+ * @brief select the conversion kernels according to CPU features
+ *
+ * Run once at load time, before any thread may read the kernel pointers.
+ */
+__attribute__((constructor))
+static void _io_png_init_kernels(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        _io_png_kernel_u8 = _io_png_u8_f32_avx2;
+        _io_png_kernel_u16 = _io_png_u16_f32_avx2;
+        _io_png_kernel_gray = _io_png_gray_f32_avx2;
+    }
+}
+#endif
+
 /*
  * READ
  */
@@ -168,7 +326,8 @@ static void *io_png_read_raw(const char *fname,
     /* parameters check */
     if (NULL == fname || NULL == nxp || NULL == nyp || NULL == ncp)
         return NULL;
-    if (IO_PNG_U8 != dtype && IO_PNG_F32 != dtype)
+    if (IO_PNG_U8 != dtype && IO_PNG_F32 != dtype
+        && IO_PNG_F32_GRAY != dtype && IO_PNG_F32_PLANAR != dtype)
         return NULL;
 
     /* open the PNG input file */
@@ -213,7 +372,9 @@ static void *io_png_read_raw(const char *fname,
      * PNG_TRANSFORM_PACKING       expand 1, 2 and 4-bit
      *                             samples to bytes
      */
-    png_transform |= (PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_PACKING);
+    png_transform |= PNG_TRANSFORM_PACKING;
+    if (IO_PNG_F32_PLANAR != dtype)
+        png_transform |= PNG_TRANSFORM_STRIP_16;
 
     /* convert palette to RGB */
     png_set_palette_to_rgb(png_ptr);
@@ -253,14 +414,39 @@ static void *io_png_read_raw(const char *fname,
         if (NULL == (data_f32 = (float *) malloc(size * sizeof(float))))
             return _io_png_read_abort(fp, &png_ptr, &info_ptr);
         data = (void *) data_f32;
-        data_f32_ptr = data_f32;
+        for (j = 0; j < *nyp; j++)
+            _io_png_kernel_u8(row_pointers[j], 1,
+                              data_f32 + j * *nxp * *ncp, *nxp * *ncp);
+        break;
+    case IO_PNG_F32_GRAY: /* single pass: gray, or RGB(A) -> gray */
+        if (NULL == (data_f32 = (float *) malloc(*nxp * *nyp *
+                                                 sizeof(float))))
+            return _io_png_read_abort(fp, &png_ptr, &info_ptr);
+        data = (void *) data_f32;
         for (j = 0; j < *nyp; j++) {
             row_ptr = row_pointers[j];
-            for (i = 0; i < *nxp; i++) {
-                for (k = 0; k < *ncp; k++)
-                    *data_f32_ptr++ = (float) *row_ptr++;
-            }
+            data_f32_ptr = data_f32 + j * *nxp;
+            if (*ncp >= 3)
+                _io_png_kernel_gray(row_ptr, *ncp, data_f32_ptr, *nxp);
+            else /* gray(+alpha) */
+                _io_png_kernel_u8(row_ptr, *ncp, data_f32_ptr, *nxp);
         }
+        *ncp = 1;
+        break;
+    case IO_PNG_F32_PLANAR: /* single pass: RGB RGB RGB -> RRR GGG BBB */
+        if (NULL == (data_f32 = (float *) malloc(size * sizeof(float))))
+            return _io_png_read_abort(fp, &png_ptr, &info_ptr);
+        data = (void *) data_f32;
+        k = (16 == png_get_bit_depth(png_ptr, info_ptr)) ? 2 : 1;
+        for (j = 0; j < *nyp; j++)
+            for (i = 0; i < *ncp; i++) {
+                row_ptr = row_pointers[j] + i * k;
+                data_f32_ptr = data_f32 + (i * *nyp + j) * *nxp;
+                if (2 == k)
+                    _io_png_kernel_u16(row_ptr, *ncp, data_f32_ptr, *nxp);
+                else
+                    _io_png_kernel_u8(row_ptr, *ncp, data_f32_ptr, *nxp);
+            }
         break;
     }
 
@@ -476,26 +662,156 @@ float *io_png_read_f32_rgb(const char *fname, size_t * nxp, size_t * nyp)
 float *io_png_read_f32_gray(const char *fname, size_t * nxp, size_t * nyp)
 {
     size_t nc;
-    float *img, *ptr_end, *p, *q;
 
-    /* read the image */
-    img = (float *) io_png_read_raw(fname, nxp, nyp, &nc,
-                                    PNG_TRANSFORM_STRIP_ALPHA, IO_PNG_F32);
-    if (NULL == img)
-        /* error */
+    /* read and convert the image in a single pass */
+    return (float *) io_png_read_raw(fname, nxp, nyp, &nc,
+                                     PNG_TRANSFORM_IDENTITY, IO_PNG_F32_GRAY);
+}
+
+/**
+ * @brief read a PNG file into a 32bit float array, channels in planes
+ *
+ * The array contains the channels one after the other (RRR..GGG..BBB..).
+ * Unlike io_png_read_f32(), 16bit images are not downscaled, their values
+ * are between 0. and 65535.
+ *
+ * @param fname PNG file name
+ * @param nxp, nyp, ncp pointers to variables to be filled with the number of
+ *        columns, lines and channels of the image
+ * @return pointer to an allocated float array of pixels,
+ *         or NULL if an error happens
+ */
+float *io_png_read_f32_planar(const char *fname,
+                              size_t * nxp, size_t * nyp, size_t * ncp)
+{
+    return (float *) io_png_read_raw(fname, nxp, nyp, ncp,
+                                     PNG_TRANSFORM_IDENTITY,
+                                     IO_PNG_F32_PLANAR);
+}
+
+/**
+ * @brief read a window of a PNG file into a 32bit float array, converted
+ * to gray
+ *
+ * Only the rows up to the last one of the window are decoded, one at a
+ * time, and only the window is allocated. Interlaced images need the full
+ * image to be decoded.
+ *
+ * @param fname PNG file name, "-" means stdin
+ * @param x0, y0 top-left pixel of the window
+ * @param nxp, nyp pointers to the size of the window, clipped to the image
+ * @param wp, hp pointers to variables to be filled with the size of the
+ *        image
+ * @return pointer to an allocated float array of the window, or NULL if an
+ *         error happens or the window is outside the image
+ */
+float *io_png_read_f32_gray_roi(const char *fname, size_t x0, size_t y0,
+                                size_t * nxp, size_t * nyp,
+                                size_t * wp, size_t * hp)
+{
+    png_byte png_sig[PNG_SIG_LEN];
+    png_structp png_ptr;
+    png_infop info_ptr;
+    /* volatile: because of setjmp/longjmp */
+    png_bytep volatile row = NULL;
+    png_bytepp volatile rows = NULL;
+    float *volatile data = NULL;
+    FILE *volatile fp = NULL;
+    size_t nc, j, y1;
+    int npass;
+    _io_png_err_t err;
+
+    if (NULL == fname || NULL == nxp || NULL == nyp
+        || NULL == wp || NULL == hp)
         return NULL;
-    if (1 == nc)
-        /* already gray */
-        return img;
-    else
-    {
-        ptr_end = img + *nxp * *nyp;
-        for (p = q = img; p != ptr_end; p++, q+=3)
-            *p = rgb_to_gray(q[0], q[1], q[2]);
-        /* resize and return the image */
-        img = (float*)realloc(img, *nxp * *nyp * sizeof(float));
-        return img;
+
+    if (0 == strcmp(fname, "-"))
+        fp = stdin;
+    else if (NULL == (fp = fopen(fname, "rb")))
+        return NULL;
+    if ((PNG_SIG_LEN != fread(png_sig, 1, PNG_SIG_LEN, fp))
+        || 0 != png_sig_cmp(png_sig, (png_size_t) 0, PNG_SIG_LEN))
+        return (float *) _io_png_read_abort(fp, NULL, NULL);
+    if (NULL == (png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                                  &err, &_io_png_err_hdl,
+                                                  NULL)))
+        return (float *) _io_png_read_abort(fp, NULL, NULL);
+    if (NULL == (info_ptr = png_create_info_struct(png_ptr)))
+        return (float *) _io_png_read_abort(fp, &png_ptr, NULL);
+    if (setjmp(err.jmpbuf)) {
+        free(row);
+        if (NULL != rows)
+            free(rows[0]);
+        free(rows);
+        free(data);
+        return (float *) _io_png_read_abort(fp, &png_ptr, &info_ptr);
+    }
+    png_init_io(png_ptr, fp);
+    png_set_sig_bytes(png_ptr, PNG_SIG_LEN);
+    png_read_info(png_ptr, info_ptr);
+
+    /* same transforms as io_png_read_f32_gray() */
+    png_set_packing(png_ptr);
+    png_set_strip_16(png_ptr);
+    png_set_palette_to_rgb(png_ptr);
+    npass = png_set_interlace_handling(png_ptr);
+    png_read_update_info(png_ptr, info_ptr);
+
+    *wp = (size_t) png_get_image_width(png_ptr, info_ptr);
+    *hp = (size_t) png_get_image_height(png_ptr, info_ptr);
+    nc = (size_t) png_get_channels(png_ptr, info_ptr);
+    if (x0 >= *wp || y0 >= *hp || 0 == *nxp || 0 == *nyp)
+        return (float *) _io_png_read_abort(fp, &png_ptr, &info_ptr);
+    if (*nxp > *wp - x0)
+        *nxp = *wp - x0;
+    if (*nyp > *hp - y0)
+        *nyp = *hp - y0;
+    y1 = y0 + *nyp;
+    if (NULL == (data = (float *) malloc(*nxp * *nyp * sizeof(float))))
+        return (float *) _io_png_read_abort(fp, &png_ptr, &info_ptr);
+
+    if (1 == npass) { /* one row buffer, stop after the window */
+        if (NULL == (row = (png_bytep)
+                     malloc(png_get_rowbytes(png_ptr, info_ptr)))) {
+            free(data);
+            return (float *) _io_png_read_abort(fp, &png_ptr, &info_ptr);
+        }
+        for (j = 0; j < y1; j++) {
+            png_read_row(png_ptr, row, NULL);
+            if (j < y0)
+                continue;
+            if (nc >= 3)
+                _io_png_kernel_gray(row + x0 * nc, nc,
+                                    data + (j - y0) * *nxp, *nxp);
+            else
+                _io_png_kernel_u8(row + x0 * nc, nc,
+                                  data + (j - y0) * *nxp, *nxp);
+        }
+        free(row);
+    } else { /* interlaced: all passes over the full image */
+        size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+        if (NULL == (rows = (png_bytepp) malloc(*hp * sizeof(png_bytep)))
+            || NULL == (rows[0] = (png_bytep) malloc(*hp * rowbytes))) {
+            free(rows);
+            free(data);
+            return (float *) _io_png_read_abort(fp, &png_ptr, &info_ptr);
+        }
+        for (j = 1; j < *hp; j++)
+            rows[j] = rows[0] + j * rowbytes;
+        png_read_image(png_ptr, rows);
+        for (j = y0; j < y1; j++)
+            if (nc >= 3)
+                _io_png_kernel_gray(rows[j] + x0 * nc, nc,
+                                    data + (j - y0) * *nxp, *nxp);
+            else
+                _io_png_kernel_u8(rows[j] + x0 * nc, nc,
+                                  data + (j - y0) * *nxp, *nxp);
+        free(rows[0]);
+        free(rows);
     }
+
+    (void) _io_png_read_abort(fp, &png_ptr, &info_ptr);
+    return data;
 }
 
 /*
@@ -527,37 +843,281 @@ static int _io_png_write_abort(FILE * fp,
     return -1;
 }
 
+/**
+ * @brief default output options: libpng defaults, 8bit, interlaced
+ */
+void io_png_opt_default(io_png_opt * opt)
+{
+    opt->level = -1;
+    opt->filter = -1;
+    opt->depth = 8;
+    opt->interlace = 1;
+    opt->strips = 1;
+}
+
+/*
+ * strip-parallel encoder
+ */
+
+/** @brief write 32bit big-endian integer */
+static void _io_png_put32(png_byte * p, png_uint_32 v)
+{
+    p[0] = (png_byte) (v >> 24);
+    p[1] = (png_byte) (v >> 16);
+    p[2] = (png_byte) (v >> 8);
+    p[3] = (png_byte) v;
+}
+
+/**
+ * @brief write a PNG chunk
+ * @return 0 if everything OK, -1 if an error occured
+ */
+static int _io_png_write_chunk(FILE * fp, const char *type,
+                               const png_byte * buf, size_t len)
+{
+    png_byte head[8], tail[4];
+    uLong crc;
+
+    _io_png_put32(head, (png_uint_32) len);
+    memcpy(head + 4, type, 4);
+    crc = crc32(crc32(0L, Z_NULL, 0), head + 4, 4);
+    if (len > 0)
+        crc = crc32(crc, buf, (uInt) len);
+    _io_png_put32(tail, (png_uint_32) crc);
+    if (8 != fwrite(head, 1, 8, fp)
+        || len != fwrite(buf, 1, len, fp) || 4 != fwrite(tail, 1, 4, fp))
+        return -1;
+    return 0;
+}
+
+/** @brief Paeth predictor of PNG filter type 4 */
+static png_byte _io_png_paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return (png_byte) a;
+    return (png_byte) (pb <= pc ? b : c);
+}
+
+/**
+ * @brief filter a row with the given PNG filter type
+ *
+ * @param out output, filter type byte followed by filtered bytes
+ * @param row, prev current and previous rows (prev NULL for first row)
+ * @param n, bpp bytes per row and bytes per pixel
+ */
+static void _io_png_filter_row(png_byte * out, const png_byte * row,
+                               const png_byte * prev, size_t n, size_t bpp,
+                               int type)
+{
+    size_t i;
+    *out++ = (png_byte) type;
+    for (i = 0; i < n; i++) {
+        int a = (i >= bpp) ? row[i - bpp] : 0;
+        int b = prev ? prev[i] : 0;
+        int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+        switch (type) {
+        case PNG_FILTER_VALUE_SUB:
+            out[i] = (png_byte) (row[i] - a);
+            break;
+        case PNG_FILTER_VALUE_UP:
+            out[i] = (png_byte) (row[i] - b);
+            break;
+        case PNG_FILTER_VALUE_AVG:
+            out[i] = (png_byte) (row[i] - ((a + b) >> 1));
+            break;
+        case PNG_FILTER_VALUE_PAETH:
+            out[i] = (png_byte) (row[i] - _io_png_paeth(a, b, c));
+            break;
+        default:
+            out[i] = row[i];
+        }
+    }
+}
+
+/**
+ * @brief write a non-interlaced PNG, deflating strips of rows in parallel
+ *
+ * Each strip is compressed independently as raw deflate data ended by a
+ * full flush, except the last one, so that their concatenation is a valid
+ * deflate stream. The zlib header and the combined Adler-32 checksum frame
+ * them into one zlib stream, written as one IDAT chunk per strip.
+ *
+ * @param fp output file
+ * @param idata interleaved image data, ny rows of rowbytes bytes
+ * @param ihdr IHDR chunk data
+ * @param opt options, opt->strips is clamped to [1, ny]
+ * @return 0 if everything OK, -1 if an error occured (or ny is 0)
+ */
+static int _io_png_write_strips(FILE * fp, const png_byte * idata,
+                                size_t ny, size_t rowbytes, size_t bpp,
+                                const png_byte ihdr[13],
+                                const io_png_opt * opt)
+{
+    const png_byte sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    int nstrips = opt->strips, level = opt->level, s, err = 0;
+    int type = (opt->filter < 0 || opt->filter > 4) ? PNG_FILTER_VALUE_UP
+        : opt->filter;
+    size_t rows;
+    png_byte **zbuf;
+    size_t *zlen;
+    uLong *adler, *ulen, check;
+    png_byte zhead[2], trailer[4];
+
+    if (0 == ny || 0 == rowbytes)
+        return -1;
+    if (level < 0 || level > 9)
+        level = Z_DEFAULT_COMPRESSION;
+    /* at least one strip, at least one row per strip */
+    if (nstrips < 1)
+        nstrips = 1;
+    if ((size_t) nstrips > ny)
+        nstrips = (int) ny;
+    rows = (ny + nstrips - 1) / nstrips;
+    nstrips = (int) ((ny + rows - 1) / rows);
+    zbuf = (png_byte **) calloc(nstrips, sizeof(png_byte *));
+    zlen = (size_t *) calloc(nstrips, sizeof(size_t));
+    adler = (uLong *) calloc(nstrips, sizeof(uLong));
+    ulen = (uLong *) calloc(nstrips, sizeof(uLong));
+    if (NULL == zbuf || NULL == zlen || NULL == adler || NULL == ulen)
+        err = 1;
+
+    /* a strip failing leaves its buffer NULL */
+    if (!err) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (s = 0; s < nstrips; s++) {
+            size_t j, j0 = s * rows, j1 = j0 + rows;
+            png_byte *fbuf;
+            z_stream z;
+            uLong bound;
+            int ret;
+
+            if (j1 > ny)
+                j1 = ny;
+            ulen[s] = (uLong) ((j1 - j0) * (rowbytes + 1));
+            fbuf = (png_byte *) malloc(ulen[s]);
+            memset(&z, 0, sizeof(z));
+            if (NULL == fbuf
+                || Z_OK != deflateInit2(&z, level, Z_DEFLATED, -15, 8,
+                                        Z_DEFAULT_STRATEGY)) {
+                free(fbuf);
+                continue;
+            }
+            for (j = j0; j < j1; j++)
+                _io_png_filter_row(fbuf + (j - j0) * (rowbytes + 1),
+                                   idata + j * rowbytes,
+                                   j ? idata + (j - 1) * rowbytes : NULL,
+                                   rowbytes, bpp, type);
+            adler[s] = adler32(adler32(0L, Z_NULL, 0), fbuf, (uInt) ulen[s]);
+            bound = deflateBound(&z, ulen[s]) + 16;
+            if (NULL != (zbuf[s] = (png_byte *) malloc(bound))) {
+                z.next_in = fbuf;
+                z.avail_in = (uInt) ulen[s];
+                z.next_out = zbuf[s];
+                z.avail_out = (uInt) bound;
+                ret = deflate(&z, s + 1 == nstrips ? Z_FINISH : Z_FULL_FLUSH);
+                zlen[s] = bound - z.avail_out;
+                if (Z_STREAM_ERROR == ret || 0 != z.avail_in) {
+                    free(zbuf[s]);
+                    zbuf[s] = NULL;
+                }
+            }
+            deflateEnd(&z);
+            free(fbuf);
+        }
+        for (s = 0; s < nstrips; s++)
+            if (NULL == zbuf[s])
+                err = 1;
+    }
+
+    if (!err) {
+        /* zlib header, with compression level hint */
+        zhead[0] = 0x78;
+        zhead[1] = (level == 0 || level == 1) ? 0x01 :
+            (level > 1 && level < 6) ? 0x5e : (level > 6) ? 0xda : 0x9c;
+        check = adler[0];
+        for (s = 1; s < nstrips; s++)
+            check = adler32_combine(check, adler[s], (z_off_t) ulen[s]);
+        _io_png_put32(trailer, (png_uint_32) check);
+        if (8 != fwrite(sig, 1, 8, fp)
+            || 0 != _io_png_write_chunk(fp, "IHDR", ihdr, 13))
+            err = 1;
+    }
+    for (s = 0; s < nstrips && !err; s++) {
+        /* first IDAT starts with zlib header, last ends with checksum */
+        png_byte *buf = zbuf[s];
+        size_t len = zlen[s];
+        if (0 == s || s + 1 == nstrips) {
+            buf = (png_byte *) malloc(len + 6);
+            if (NULL == buf) {
+                err = 1;
+                break;
+            }
+            len = 0;
+            if (0 == s) {
+                memcpy(buf, zhead, 2);
+                len = 2;
+            }
+            memcpy(buf + len, zbuf[s], zlen[s]);
+            len += zlen[s];
+            if (s + 1 == nstrips) {
+                memcpy(buf + len, trailer, 4);
+                len += 4;
+            }
+        }
+        if (0 != _io_png_write_chunk(fp, "IDAT", buf, len))
+            err = 1;
+        if (buf != zbuf[s])
+            free(buf);
+    }
+    if (!err && 0 != _io_png_write_chunk(fp, "IEND", NULL, 0))
+        err = 1;
+
+    for (s = 0; NULL != zbuf && s < nstrips; s++)
+        free(zbuf[s]);
+    free(zbuf);
+    free(zlen);
+    free(adler);
+    free(ulen);
+    return err ? -1 : 0;
+}
+
 /**
  * @brief internal function used to write a byte array as a PNG file
  *
- * The PNG file is written as a 8bit image file, interlaced,
- * truecolor. Depending on the number of channels, the color model is
+ * The PNG file is written as a 8bit or 16bit image file, truecolor.
+ * Depending on the number of channels, the color model is
  * gray, gray+alpha, rgb, rgb+alpha.
  *
- * @todo handle 16bit
- *
  * @param fname PNG file name, "-" means stdout
  * @param data deinterlaced (RRR..GGG..BBB..AAA) image byte array
  * @param nx, ny, nc number of columns, lines and channels
  * @param dtype identifier for the data type to be used for output
+ * @param opt output options, NULL for defaults (see io_png_opt_default())
  * @return 0 if everything OK, -1 if an error occured
  */
 static int io_png_write_raw(const char *fname, const void *data,
-                            size_t nx, size_t ny, size_t nc, int dtype)
+                            size_t nx, size_t ny, size_t nc, int dtype,
+                            const io_png_opt * opt)
 {
     png_structp png_ptr;
     png_infop info_ptr;
     png_byte *idata = NULL, *idata_ptr = NULL;
     png_bytep *row_pointers = NULL;
-    png_byte bit_depth;
+    png_byte ihdr[13];
     /* volatile: because of setjmp/longjmp */
+    volatile png_byte bit_depth;
     FILE *volatile fp;
     const unsigned char *data_u8 = NULL;
     const unsigned char *data_u8_ptr = NULL;
     const float *data_f32 = NULL;
     const float *data_f32_ptr = NULL;
-    float tmp;
+    float tmp, vmax;
     int color_type, interlace, compression, filter;
+    io_png_opt o; /* copy, not to reassign the argument before setjmp */
     size_t size;
     size_t i, j, k;
     /* error structure */
@@ -570,45 +1130,11 @@ static int io_png_write_raw(const char *fname, const void *data,
         return -1;
     if (IO_PNG_U8 != dtype && IO_PNG_F32 != dtype)
         return -1;
-
-    /* open the PNG output file */
-    if (0 == strcmp(fname, "-"))
-        fp = stdout;
-    else if (NULL == (fp = fopen(fname, "wb")))
-        return -1;
-
-    /* allocate the interlaced array and row pointers */
-    size = nx * ny * nc;
-    if (NULL == (idata = (png_byte *) malloc(size * sizeof(png_byte))))
-        return _io_png_write_abort(fp, NULL, NULL, NULL, NULL);
-
-    if (NULL == (row_pointers = (png_bytep *) malloc(ny * sizeof(png_bytep))))
-        return _io_png_write_abort(fp, idata, NULL, NULL, NULL);
-
-    /*
-     * create and initialize the png_struct
-     * with local error handling
-     */
-    if (NULL == (png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
-                                                   &err, &_io_png_err_hdl,
-                                                   NULL)))
-        return _io_png_write_abort(fp, idata, row_pointers, NULL, NULL);
-
-    /* allocate/initialize the memory for image information */
-    if (NULL == (info_ptr = png_create_info_struct(png_ptr)))
-        return _io_png_write_abort(fp, idata, row_pointers, &png_ptr, NULL);
-
-    /* handle write errors */
-    if (0 != setjmp(err.jmpbuf))
-        /* if we get here, we had a problem writing to the file */
-        return _io_png_write_abort(fp, idata, row_pointers, &png_ptr,
-                                   &info_ptr);
-
-    /* set up the input control using standard C streams */
-    png_init_io(png_ptr, fp);
-
-    /* set image informations */
-    bit_depth = 8;
+    if (NULL == opt)
+        io_png_opt_default(&o);
+    else
+        o = *opt;
+    bit_depth = (16 == o.depth && IO_PNG_F32 == dtype) ? 16 : 8;
     switch (nc) {
     case 1:
         color_type = PNG_COLOR_TYPE_GRAY;
@@ -623,21 +1149,19 @@ static int io_png_write_raw(const char *fname, const void *data,
         color_type = PNG_COLOR_TYPE_RGB_ALPHA;
         break;
     default:
-        png_destroy_read_struct(&png_ptr, NULL, NULL);
-        free(row_pointers);
-        free(idata);
-        (void) fclose(fp);
         return -1;
     }
-    interlace = PNG_INTERLACE_ADAM7;
-    compression = PNG_COMPRESSION_TYPE_BASE;
-    filter = PNG_FILTER_TYPE_BASE;
 
-    /* set image header */
-    png_set_IHDR(png_ptr, info_ptr, (png_uint_32) nx, (png_uint_32) ny,
-                 bit_depth, color_type, interlace, compression, filter);
-    /* TODO : significant bit (sBIT), gamma (gAMA), comments (text) chunks */
-    png_write_info(png_ptr, info_ptr);
+    /* open the PNG output file */
+    if (0 == strcmp(fname, "-"))
+        fp = stdout;
+    else if (NULL == (fp = fopen(fname, "wb")))
+        return -1;
+
+    /* allocate the interlaced array and row pointers */
+    size = nx * ny * nc * (bit_depth / 8);
+    if (NULL == (idata = (png_byte *) malloc(size * sizeof(png_byte))))
+        return _io_png_write_abort(fp, NULL, NULL, NULL, NULL);
 
     switch (dtype) {
     case IO_PNG_U8: /* pure copy data -> idata */
@@ -654,9 +1178,10 @@ static int io_png_write_raw(const char *fname, const void *data,
             }
         }
         break;
-    case IO_PNG_F32: /* copy and clip to [0,255] data -> idata */
+    case IO_PNG_F32: /* copy and clip to [0,255] or [0,65535] data -> idata */
         data_f32_ptr = data_f32 = (float *) data;
         idata_ptr = idata;
+        vmax = (16 == bit_depth) ? 65535.f : 255.f;
         for (j = 0; j < ny; j++) {
             /* row loop */
             for (i = 0; i < nx; i++) {
@@ -664,17 +1189,79 @@ static int io_png_write_raw(const char *fname, const void *data,
                 for (k = 0; k < nc; k++) {
                     /* channel loop */
                     tmp = (float)floor(*data_f32_ptr++ + .5f);
-                    *idata_ptr++ = (png_byte) (tmp < 0. ? 0. :
-                                               (tmp > 255. ? 255. : tmp));
+                    tmp = (tmp < 0.f ? 0.f : (tmp > vmax ? vmax : tmp));
+                    if (16 == bit_depth) /* PNG is big-endian */
+                        *idata_ptr++ = (png_byte) ((unsigned) tmp >> 8);
+                    *idata_ptr++ = (png_byte) ((unsigned) tmp & 0xff);
                 }
             }
         }
         break;
     }
 
+    if (o.strips > 1) {
+        /* non-interlaced, strip-parallel compression */
+        _io_png_put32(ihdr, (png_uint_32) nx);
+        _io_png_put32(ihdr + 4, (png_uint_32) ny);
+        ihdr[8] = bit_depth;
+        ihdr[9] = (png_byte) color_type;
+        ihdr[10] = ihdr[11] = ihdr[12] = 0;
+        i = nc * (bit_depth / 8); /* bytes per pixel */
+        if (0 != _io_png_write_strips(fp, idata, ny, nx * i, i, ihdr, &o))
+            return _io_png_write_abort(fp, idata, NULL, NULL, NULL);
+        (void) _io_png_write_abort(fp, idata, NULL, NULL, NULL);
+        return 0;
+    }
+
+    if (NULL == (row_pointers = (png_bytep *) malloc(ny * sizeof(png_bytep))))
+        return _io_png_write_abort(fp, idata, NULL, NULL, NULL);
+
+    /*
+     * create and initialize the png_struct
+     * with local error handling
+     */
+    if (NULL == (png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                                   &err, &_io_png_err_hdl,
+                                                   NULL)))
+        return _io_png_write_abort(fp, idata, row_pointers, NULL, NULL);
+
+    /* allocate/initialize the memory for image information */
+    if (NULL == (info_ptr = png_create_info_struct(png_ptr)))
+        return _io_png_write_abort(fp, idata, row_pointers, &png_ptr, NULL);
+
+    /* handle write errors */
+    if (0 != setjmp(err.jmpbuf))
+        /* if we get here, we had a problem writing to the file */
+        return _io_png_write_abort(fp, idata, row_pointers, &png_ptr,
+                                   &info_ptr);
+
+    /* set up the input control using standard C streams */
+    png_init_io(png_ptr, fp);
+
+    /* set compression level and row filters */
+    if (o.level >= 0 && o.level <= 9)
+        png_set_compression_level(png_ptr, o.level);
+    if (o.filter >= 0 && o.filter <= 4) {
+        const int filters[] = { PNG_FILTER_NONE, PNG_FILTER_SUB,
+            PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH
+        };
+        png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, filters[o.filter]);
+    }
+
+    /* set image informations */
+    interlace = o.interlace ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE;
+    compression = PNG_COMPRESSION_TYPE_BASE;
+    filter = PNG_FILTER_TYPE_BASE;
+
+    /* set image header */
+    png_set_IHDR(png_ptr, info_ptr, (png_uint_32) nx, (png_uint_32) ny,
+                 bit_depth, color_type, interlace, compression, filter);
+    /* TODO : significant bit (sBIT), gamma (gAMA), comments (text) chunks */
+    png_write_info(png_ptr, info_ptr);
+
     /* set row pointers */
     for (j = 0; j < ny; j++)
-        row_pointers[j] = idata + (size_t) (nc * nx * j);
+        row_pointers[j] = idata + (size_t) (nc * nx * (bit_depth / 8) * j);
 
     /* write out the entire image and end it */
     png_write_image(png_ptr, row_pointers);
@@ -699,7 +1286,7 @@ int io_png_write_u8(const char *fname, const unsigned char *data,
 {
     return io_png_write_raw(fname, (void *) data,
                             (png_uint_32) nx, (png_uint_32) ny, (png_byte) nc,
-                            IO_PNG_U8);
+                            IO_PNG_U8, NULL);
 }
 
 /**
@@ -707,8 +1294,6 @@ int io_png_write_u8(const char *fname, const unsigned char *data,
  *
  * The float values are rounded to 8bit integers, and bounded to [0, 255].
  *
- * @todo handle 16bit images and flexible min/max
- *
  * @param fname PNG file name
  * @param data array to write
  * @param nx, ny, nc number of columns, lines and channels of the image
@@ -719,7 +1304,58 @@ int io_png_write_f32(const char *fname, const float *data,
 {
     return io_png_write_raw(fname, (void *) data,
                             (png_uint_32) nx, (png_uint_32) ny, (png_byte) nc,
-                            IO_PNG_F32);
+                            IO_PNG_F32, NULL);
+}
+
+/**
+ * @brief write a float array into a PNG file, with output options
+ *
+ * The float values are rounded to 8bit or 16bit integers according to
+ * opt->depth, and bounded to [0, 255] or [0, 65535]. With opt->strips > 1,
+ * the image is not interlaced and strips of rows are compressed in
+ * parallel (when compiled with OpenMP), libpng is not used.
+ *
+ * @param fname PNG file name
+ * @param data array to write
+ * @param nx, ny, nc number of columns, lines and channels of the image
+ * @param opt output options, NULL for defaults
+ * @return 0 if everything OK, -1 if an error occured
+ */
+int io_png_write_f32_opt(const char *fname, const float *data,
+                         size_t nx, size_t ny, size_t nc,
+                         const io_png_opt * opt)
+{
+    return io_png_write_raw(fname, (void *) data,
+                            (png_uint_32) nx, (png_uint_32) ny, (png_byte) nc,
+                            IO_PNG_F32, opt);
+}
+
+/**
+ * @brief write a float array as raw native 32bit floats, without header
+ *
+ * @param fname file name, "-" means stdout
+ * @param data array to write
+ * @param nx, ny, nc number of columns, lines and channels of the image
+ * @return 0 if everything OK, -1 if an error occured
+ */
+int io_raw_write_f32(const char *fname, const float *data,
+                     size_t nx, size_t ny, size_t nc)
+{
+    FILE *fp;
+    size_t size = nx * ny * nc;
+    int ret = 0;
+
+    if (NULL == fname || NULL == data)
+        return -1;
+    if (0 == strcmp(fname, "-"))
+        fp = stdout;
+    else if (NULL == (fp = fopen(fname, "wb")))
+        return -1;
+    if (size != fwrite(data, sizeof(float), size, fp))
+        ret = -1;
+    if (stdout != fp && 0 != fclose(fp))
+        ret = -1;
+    return ret;
 }
 
 /**
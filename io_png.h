@@ -30,6 +30,16 @@ extern "C" {
 #include <stddef.h>
 
 
+/** output options of io_png_write_f32_opt() */
+typedef struct io_png_opt_s {
+    int level;      /**< zlib compression level 0..9, -1 for default */
+    int filter;     /**< PNG filter type 0..4 (none, sub, up, avg, paeth),
+                         -1 for default */
+    int depth;      /**< bit depth, 8 or 16 */
+    int interlace;  /**< Adam7 interlacing if non-zero (not with strips) */
+    int strips;     /**< number of strips deflated in parallel, 1 for libpng */
+} io_png_opt;
+
 /* io_png.c */
 char *io_png_info(void);
 unsigned char *io_png_read_u8(const char *fname, size_t *nxp, size_t *nyp, size_t *ncp);
@@ -38,8 +48,13 @@ unsigned char *io_png_read_u8_gray(const char *fname, size_t *nxp, size_t *nyp);
 float *io_png_read_f32(const char *fname, size_t *nxp, size_t *nyp, size_t *ncp);
 float *io_png_read_f32_rgb(const char *fname, size_t *nxp, size_t *nyp);
 float *io_png_read_f32_gray(const char *fname, size_t *nxp, size_t *nyp);
+float *io_png_read_f32_planar(const char *fname, size_t *nxp, size_t *nyp, size_t *ncp);
+float *io_png_read_f32_gray_roi(const char *fname, size_t x0, size_t y0, size_t *nxp, size_t *nyp, size_t *wp, size_t *hp);
 int io_png_write_u8(const char *fname, const unsigned char *data, size_t nx, size_t ny, size_t nc);
 int io_png_write_f32(const char *fname, const float *data, size_t nx, size_t ny, size_t nc);
+void io_png_opt_default(io_png_opt *opt);
+int io_png_write_f32_opt(const char *fname, const float *data, size_t nx, size_t ny, size_t nc, const io_png_opt *opt);
+int io_raw_write_f32(const char *fname, const float *data, size_t nx, size_t ny, size_t nc);
 
 float rgb_to_gray(float r, float g, float b);
 
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file levelline.cpp
+ * @brief Level lines of the bilinear image along continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "levelline.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+/// Bilinear functions on rectangles [u0,u1]x[v0,v1] of dual pixels, in
+/// coordinates relative to their top-left corner, from the levels at the
+/// corners: f(u,v)=a+bu+cv+duv with a=l00, b=l10-l00, c=l01-l00 and
+/// d=l11-l10-l01+l00.
+struct Patch {
+    std::vector<double> l00, l10, l01, l11, u0, u1, v0, v1;
+    void resize(size_t n) {
+        l00.resize(n); l10.resize(n); l01.resize(n); l11.resize(n);
+        u0.resize(n); u1.resize(n); v0.resize(n); v1.resize(n);
+    }
+};
+
+/// Endpoints A and B of the arc of level line in a dual pixel, in
+/// coordinates relative to its top-left corner. NaN if there is no arc.
+struct Arc {
+    double uA, vA, uB, vB;
+};
+
+/// Keep in (\a uA,\a vA)-(\a uB,\a vB) the pair of points (\a u1,\a v1) and
+/// (\a u2,\a v2) if they are farther apart than the current pair, at squared
+/// distance \a dMax. A point with a NaN coordinate is never kept. Selections
+/// are without branches, so that the calling loop is vectorized.
+static inline void farther(double u1, double v1, double u2, double v2,
+                           double& dMax,
+                           double& uA, double& vA, double& uB, double& vB) {
+    const double dd = (u2-u1)*(u2-u1)+(v2-v1)*(v2-v1);
+    const bool g = dd > dMax; // False if NaN
+    dMax = g? dd: dMax;
+    uA = g? u1: uA; vA = g? v1: vA;
+    uB = g? u2: uB; vB = g? v2: vB;
+}
+
+/// Value \a t restricted to the interval of bounds \a s and \a e. At the level
+/// of the saddle, the arc degenerates to edges and \a t may be NaN.
+static double clamp(double t, double s, double e) {
+    if(e < s)
+        std::swap(s, e);
+    return std::max(s, std::min(e, t)); // NaN gives e
+}
+
+/// Level line at \a lvl through the mme of continuum \a iCtn, sampled by
+/// \a nPts>=2 points in each mme it crosses. In an mme, the bilinear image
+/// is monotone in x and y (the saddle is at a corner), so the level line is
+/// a single arc of hyperbola. Points are written in \a out, which must have
+/// room for (nPts+1) points per mme. Consecutive arcs are oriented and
+/// joined; pieces that do not join are separated by a point of NaN
+/// coordinates. Return the number of points written.
+int level_line(const CC& cc, int iCtn, float lvl, int nPts, DPoint* out) {
+    const std::vector<Mme>& mme = cc.continua[iCtn].mme;
+    const size_t n = mme.size();
+    const double l = lvl;
+    // Gather corner levels and frame of all mme, structure of arrays. The
+    // accesses to the C&C are indirect, this pass is scalar.
+    Patch P;
+    P.resize(n);
+    for(size_t k=0; k<n; k++) {
+        int i=mme[k].cell(), x=i%cc.w, y=i/cc.w;
+        DPoint p=cc.point(mme[k]), q=cc.mme_br(p);
+        P.l00[k]=cc.contours[i].lvl;      P.l10[k]=cc.contours[i+1].lvl;
+        P.l01[k]=cc.contours[i+cc.w].lvl; P.l11[k]=cc.contours[i+cc.w+1].lvl;
+        P.u0[k]=p.x-x; P.u1[k]=q.x-x; P.v0[k]=p.y-y; P.v1[k]=q.y-y;
+    }
+    // Endpoints of arc on the frame of each mme: the intersections with the
+    // four sides are all computed, those outside their side are replaced by
+    // NaN (a side parallel to the level line gives an infinite or NaN
+    // parameter, discarded too) and the farthest pair is kept, corners being
+    // found twice. Without branches and with a single output array, this
+    // pass is vectorized.
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<Arc> arc(n);
+    for(size_t k=0; k<n; k++) {
+        const double a=P.l00[k], b=P.l10[k]-a, c=P.l01[k]-a;
+        const double d=P.l11[k]-P.l10[k]-P.l01[k]+a;
+        const double u0=P.u0[k], u1=P.u1[k], v0=P.v0[k], v1=P.v1[k];
+        double t0=(l-a-c*v0)/(b+d*v0), t1=(l-a-c*v1)/(b+d*v1);
+        double t2=(l-a-b*u0)/(c+d*u0), t3=(l-a-b*u1)/(c+d*u1);
+        t0 = (u0<=t0 && t0<=u1)? t0: nan;
+        t1 = (u0<=t1 && t1<=u1)? t1: nan;
+        t2 = (v0<=t2 && t2<=v1)? t2: nan;
+        t3 = (v0<=t3 && t3<=v1)? t3: nan;
+        double dMax=-1, uA=0, vA=0, uB=0, vB=0;
+        farther(t0,v0, t1,v1, dMax, uA,vA,uB,vB);
+        farther(t0,v0, u0,t2, dMax, uA,vA,uB,vB);
+        farther(t0,v0, u1,t3, dMax, uA,vA,uB,vB);
+        farther(t1,v1, u0,t2, dMax, uA,vA,uB,vB);
+        farther(t1,v1, u1,t3, dMax, uA,vA,uB,vB);
+        farther(u0,t2, u1,t3, dMax, uA,vA,uB,vB);
+        const bool ok = dMax > 0; // Distinct endpoints
+        arc[k].uA = ok? uA: nan; arc[k].vA = ok? vA: nan;
+        arc[k].uB = ok? uB: nan; arc[k].vB = ok? vB: nan;
+    }
+    // Orient and sample arcs
+    const double eps = 1e-9;
+    int nOut=0;
+    bool open=false; // Last written point ends a piece that may continue
+    for(size_t k=0; k<n; k++) {
+        Arc& r = arc[k];
+        if(std::isnan(r.uA)) { // No arc
+            open = false;
+            continue;
+        }
+        int i=mme[k].cell();
+        const double x=i%cc.w, y=i/cc.w;
+        DPoint A(x+r.uA,y+r.vA), B(x+r.uB,y+r.vB);
+        if(! open && k+1<n && ! std::isnan(arc[k+1].uA)) { // End at next arc
+            const Arc& r1 = arc[k+1];
+            int j=mme[k+1].cell();
+            double xj=j%cc.w-x, yj=j/cc.w-y;
+            if((std::abs(r.uA-xj-r1.uA)<eps && std::abs(r.vA-yj-r1.vA)<eps) ||
+               (std::abs(r.uA-xj-r1.uB)<eps && std::abs(r.vA-yj-r1.vB)<eps)) {
+                std::swap(r.uA,r.uB); std::swap(r.vA,r.vB);
+            }
+        }
+        if(open) {
+            const DPoint& e = out[nOut-1];
+            bool joinA = std::abs(e.x-A.x)<eps && std::abs(e.y-A.y)<eps;
+            bool joinB = std::abs(e.x-B.x)<eps && std::abs(e.y-B.y)<eps;
+            if(joinB && !joinA) {
+                std::swap(r.uA,r.uB); std::swap(r.vA,r.vB);
+            }
+            if(! joinA && ! joinB)
+                out[nOut++] = DPoint(nan,nan);
+            open = joinA || joinB;
+        }
+        const double a=P.l00[k], b=P.l10[k]-a, c=P.l01[k]-a;
+        const double d=P.l11[k]-P.l10[k]-P.l01[k]+a;
+        const double u0=r.uA, du=r.uB-r.uA, v0=r.vA, dv=r.vB-r.vA;
+        DPoint* o = out+nOut;
+        const int first = open? 1: 0; // Skip point shared with previous arc
+        // Graph over the coordinate of larger extent: the arc is monotone, so
+        // the other one stays in the bounding box of its endpoints.
+        if(std::abs(du) >= std::abs(dv))
+            for(int s=first; s<nPts; s++) {
+                double u = u0+du*s/(nPts-1);
+                o[s-first] = DPoint(x+u, y+clamp((l-a-b*u)/(c+d*u), v0, v0+dv));
+            }
+        else
+            for(int s=first; s<nPts; s++) {
+                double v = v0+dv*s/(nPts-1);
+                o[s-first] = DPoint(x+clamp((l-a-c*v)/(b+d*v), u0, u0+du), y+v);
+            }
+        o[nPts-1-first] = DPoint(x+r.uB, y+r.vB); // Exact endpoint
+        nOut += nPts-first;
+        open = true;
+    }
+    return nOut;
+}
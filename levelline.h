@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file levelline.h
+ * @brief Level lines of the bilinear image along continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef LEVELLINE_H
+#define LEVELLINE_H
+
+#include "cc.h"
+
+int level_line(const CC& cc, int iCtn, float lvl, int nPts, DPoint* out);
+
+#endif
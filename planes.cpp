@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file planes.cpp
+ * @brief Contours & Continua of several planes of same size
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "planes.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+/// Build the C&C of the \a k consecutive planes of size \a w x \a h stored in
+/// \a im (layout RRR...GGG...BBB...). Planes are distributed over
+/// \a nThreads threads (0=number of cores), recorded in \a trace if not
+/// null.
+CCPlanes::CCPlanes(const float* im, int w, int h, int k,
+                   const CCOptions& opt, int nThreads, CCTrace* trace)
+: cc(k, (CC*)0) {
+    if(nThreads <= 0)
+        nThreads = (int)std::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads,k));
+    const size_t size = (size_t)w*h;
+    std::atomic<int> next(0);
+    ctx.trace = trace;
+    auto worker = [&]() {
+        for(int i=next++; i<k; i=next++)
+            cc[i] = new CC(im+i*size, w, h, opt, &ctx);
+    };
+    std::vector<std::thread> threads;
+    for(int t=1; t<nThreads; t++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for(size_t t=0; t<threads.size(); t++)
+        threads[t].join();
+}
+
+CCPlanes::~CCPlanes() {
+    for(size_t i=0; i<cc.size(); i++)
+        delete cc[i];
+}
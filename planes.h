@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file planes.h
+ * @brief Contours & Continua of several planes of same size
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef PLANES_H
+#define PLANES_H
+
+#include "cc.h"
+#include <vector>
+
+/// C&C of each of the planes of a multi-channel image or of a stack of
+/// frames. Planes are independent and computed concurrently.
+struct CCPlanes {
+    std::vector<CC*> cc; ///< One C&C per plane
+    CCContext ctx; ///< Shared by the constructions
+    CCPlanes(const float* im, int w, int h, int k,
+             const CCOptions& opt=CCOptions(), int nThreads=0,
+             CCTrace* trace=0);
+    ~CCPlanes();
+    CC& operator[](int i) { return *cc[i]; }
+
+    CCPlanes(const CCPlanes&) = delete;
+    CCPlanes& operator=(const CCPlanes&) = delete;
+};
+
+#endif
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file preview.cpp
+ * @brief Coarse-to-fine computation of contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "preview.h"
+#include <algorithm>
+
+/// Build the C&C of the image subsampled so that it has at most \a maxPixels
+/// pixels. Each coarse sample is the mean of its block of pixels, clipped at
+/// the border, so that thin structures are not aliased. The cost of C&C is
+/// bounded by \a maxPixels, the filtering is a linear pass over the image.
+CCPreview::CCPreview(const float* im, int w, int h, int maxPixels,
+                     const CCOptions& opt)
+: im(im), w(w), h(h), scale(1), coarse(0), opt(opt) {
+    if(maxPixels < 4)
+        maxPixels = 4;
+    while(((w+scale-1)/scale)*(size_t)((h+scale-1)/scale) > (size_t)maxPixels)
+        ++scale;
+    int cw=(w+scale-1)/scale, ch=(h+scale-1)/scale;
+    coarseIm.resize((size_t)cw*ch);
+    std::vector<double> sum(cw); // Sums of block columns of current row
+    for(int i=0; i<ch; i++) {
+        std::fill(sum.begin(), sum.end(), 0.0);
+        int y1 = std::min((i+1)*scale,h);
+        for(int y=i*scale; y<y1; y++) {
+            const float* row = im + (size_t)y*w;
+            for(int x=0; x<w; x++)
+                sum[x/scale] += row[x];
+        }
+        float* out = &coarseIm[(size_t)i*cw];
+        for(int j=0; j<cw; j++) {
+            int n = (y1-i*scale)*(std::min((j+1)*scale,w)-j*scale);
+            out[j] = (float)(sum[j]/n);
+        }
+    }
+    coarse = new CC(&coarseIm[0], cw, ch, opt);
+}
+
+CCPreview::~CCPreview() {
+    delete coarse;
+    for(size_t i=0; i<regions.size(); i++)
+        delete regions[i].cc;
+}
+
+/// Compute at full resolution the C&C of the region of pixels in rectangle
+/// of top-left \a tl and bottom-right \a br (excluded), clipped to the image.
+/// A region already refined is not recomputed.
+const CCPreview::Region& CCPreview::refine(Pos tl, Pos br) {
+    tl.x = std::min<int>(std::max<short>(tl.x,0),w-1);
+    tl.y = std::min<int>(std::max<short>(tl.y,0),h-1);
+    br.x = std::min<int>(br.x,w);   br.y = std::min<int>(br.y,h);
+    br.x = std::max<int>(br.x,tl.x+1); br.y = std::max<int>(br.y,tl.y+1);
+    for(size_t i=0; i<regions.size(); i++)
+        if(regions[i].tl==tl && regions[i].br==br)
+            return regions[i];
+    regions.push_back(Region());
+    Region& r = regions.back();
+    r.tl = tl; r.br = br;
+    int rw=br.x-tl.x, rh=br.y-tl.y;
+    r.im.resize((size_t)rw*rh);
+    for(int i=0; i<rh; i++)
+        std::copy(im+(size_t)(tl.y+i)*w+tl.x, im+(size_t)(tl.y+i)*w+br.x,
+                  r.im.begin()+(size_t)i*rw);
+    r.cc = new CC(&r.im[0], rw, rh, opt);
+    return r;
+}
+
+/// Position in the coarse level of pixel \a p of the full resolution image.
+Pos CCPreview::coarse_pos(Pos p) const {
+    return Pos(std::min<int>(p.x/scale, coarse->w-1),
+               std::min<int>(p.y/scale, coarse->h-1));
+}
+
+/// Link across scales: coarse contour corresponding to the contour of index
+/// \a i in the region \a r. A saddle is linked through its dual pixel.
+int CCPreview::link_contour(const Region& r, int i) {
+    const CC& cc = *r.cc;
+    Pos p(i%cc.w, i/cc.w);
+    if(i >= cc.w*cc.h) // Saddle
+        p = Pos((int)cc.contours[i].p.x, (int)cc.contours[i].p.y);
+    p.x += r.tl.x; p.y += r.tl.y;
+    return coarse->root_contour(coarse_pos(p));
+}
+
+/// Link across scales: coarse root continuum corresponding to the continuum
+/// of index \a i in the region \a r. Among coarse continua whose bounding box
+/// meets the one of the continuum, it is the one sharing the most dual pixels
+/// with its mme, the smallest one in case of tie. Return -1 if there is none
+/// or if mme are not kept (topology mode).
+int CCPreview::link_continuum(const Region& r, int i) {
+    CC& cc = *r.cc;
+    if(opt.topology || coarse->w < 2 || coarse->h < 2)
+        return -1;
+    i = cc.root_continuum(i);
+    const Continuum& f = cc.continua[i];
+    std::vector<int> cells; // Coarse dual pixels of mme
+    cells.reserve(f.mme.size());
+    for(size_t k=0; k<f.mme.size(); k++) {
+        int c=f.mme[k].cell();
+        Pos p = coarse_pos(Pos(c%cc.w+r.tl.x, c/cc.w+r.tl.y));
+        p.x = std::min<int>(p.x, coarse->w-2);
+        p.y = std::min<int>(p.y, coarse->h-2);
+        cells.push_back(coarse->idx(p));
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(),cells.end()), cells.end());
+    // Bounding box in coarse coordinates
+    double x0=(f.attr.tl.x+r.tl.x)/scale, y0=(f.attr.tl.y+r.tl.y)/scale;
+    double x1=(f.attr.br.x+r.tl.x)/scale, y1=(f.attr.br.y+r.tl.y)/scale;
+    int best=-1, bestCount=0;
+    double bestArea=0;
+    for(size_t j=0; j<coarse->continua.size(); j++) {
+        const Continuum& c = coarse->continua[j];
+        if(c.parent>=0 || c.attr.br.x<x0 || c.attr.tl.x>x1 ||
+           c.attr.br.y<y0 || c.attr.tl.y>y1)
+            continue;
+        int n=0;
+        for(size_t k=0; k<c.mme.size(); k++)
+            if(std::binary_search(cells.begin(),cells.end(),c.mme[k].cell()))
+                ++n;
+        if(n>bestCount || (n==bestCount && n>0 && c.attr.area<bestArea)) {
+            best=(int)j; bestCount=n; bestArea=c.attr.area;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file preview.h
+ * @brief Coarse-to-fine computation of contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "cc.h"
+#include <deque>
+#include <vector>
+
+/// C&C of a subsampled image, available at once, and C&C at full resolution
+/// of regions computed on demand.
+struct CCPreview {
+    /// Full resolution C&C of a rectangular region of the image.
+    struct Region {
+        Pos tl, br; ///< Top-left and bottom-right (excluded) pixels
+        std::vector<float> im; ///< Copy of the image in region
+        CC* cc;
+        Region(): cc(0) {}
+    };
+
+    const float* im; ///< Full resolution image, not owned
+    int w,h;
+    int scale; ///< Subsampling factor of the coarse level
+    std::vector<float> coarseIm;
+    CC* coarse; ///< C&C of the coarse level
+    std::deque<Region> regions; ///< Refined regions, references stay valid
+
+    CCOptions opt; ///< Options of construction at all scales
+
+    CCPreview(const float* im, int w, int h, int maxPixels,
+              const CCOptions& opt=CCOptions());
+    ~CCPreview();
+
+    const Region& refine(Pos tl, Pos br);
+    Pos coarse_pos(Pos p) const;
+    int link_contour(const Region& r, int i);
+    int link_continuum(const Region& r, int i);
+
+    CCPreview(const CCPreview&) = delete;
+    CCPreview& operator=(const CCPreview&) = delete;
+};
+
+#endif
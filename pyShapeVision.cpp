@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file pyShapeVision.cpp
+ * @brief Python module shapevision: C&C of arrays exposing the buffer protocol
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * The input array (float32, uint8 or uint16, 2D C-contiguous) is read in
+ * place and the GIL is released during the construction. Results are
+ * memoryviews over the memory of the C&C, numpy.asarray wraps them without
+ * copy. They stay valid as long as they are referenced.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "cc.h"
+#include <new>
+
+/// Python object owning a C&C.
+struct PyCC {
+    PyObject_HEAD
+    CC* cc;
+};
+
+/// Strided 1D or 2D view of the memory of a C&C, keeping its owner alive.
+struct PyCCView {
+    PyObject_HEAD
+    PyObject* owner;
+    char* buf;
+    const char* format;
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[2], strides[2];
+};
+
+static int view_getbuffer(PyObject* self, Py_buffer* view, int flags) {
+    PyCCView* v = (PyCCView*)self;
+    if((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "C&C views are read-only");
+        return -1;
+    }
+    view->obj = self; Py_INCREF(self);
+    view->buf = v->buf;
+    view->itemsize = v->itemsize;
+    view->len = v->itemsize*v->shape[0]*(v->ndim==2? v->shape[1]: 1);
+    view->readonly = 1;
+    view->ndim = v->ndim;
+    view->format = (flags & PyBUF_FORMAT)? (char*)v->format: NULL;
+    view->shape = v->shape;
+    view->strides = v->strides;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static void view_dealloc(PyObject* self) {
+    Py_XDECREF(((PyCCView*)self)->owner);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyBufferProcs view_as_buffer = { view_getbuffer, NULL };
+
+static PyTypeObject PyCCViewType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+/// Memoryview of \a n elements of \a format at \a buf separated by \a stride
+/// bytes. If \a cols>0, each element is a row of \a cols contiguous items.
+static PyObject* make_view(PyObject* owner, void* buf, const char* format,
+                           Py_ssize_t itemsize, Py_ssize_t n,
+                           Py_ssize_t stride, Py_ssize_t cols=0) {
+    PyCCView* v = PyObject_New(PyCCView, &PyCCViewType);
+    if(! v)
+        return NULL;
+    Py_INCREF(owner);
+    v->owner = owner;
+    v->buf = (char*)buf;
+    v->format = format;
+    v->itemsize = itemsize;
+    v->ndim = (cols>0)? 2: 1;
+    v->shape[0] = n; v->strides[0] = stride;
+    v->shape[1] = cols; v->strides[1] = itemsize;
+    PyObject* m = PyMemoryView_FromObject((PyObject*)v);
+    Py_DECREF(v);
+    return m;
+}
+
+/// Build C&C from the buffer, without the GIL. Memory exhaustion is
+/// reported through \a noMemory, the exception must not cross the Python
+/// interpreter.
+template <typename T>
+static CC* build(const Py_buffer& b, const CCOptions& opt,
+                 const unsigned char* mask, bool& noMemory) {
+    CC* cc = 0;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        cc = new CC((const T*)b.buf, (int)b.shape[1], (int)b.shape[0], opt,
+                    0, mask);
+    } catch(const std::bad_alloc&) {
+        noMemory = true;
+    }
+    Py_END_ALLOW_THREADS
+    return cc;
+}
+
+/// Skip the byte order character of a buffer format.
+static const char* format(const Py_buffer& b) {
+    const char* f = b.format? b.format: "B";
+    if(*f=='<' || *f=='=' || *f=='@')
+        ++f;
+    return f;
+}
+
+static int cc_init(PyObject* self, PyObject* args, PyObject* kwds) {
+    static const char* kwlist[] = {"image", "connectivity", "topology",
+                                   "mask", NULL};
+    PyObject *obj, *maskObj=Py_None;
+    CCOptions opt;
+    int connectivity=0, topology=0;
+    if(! PyArg_ParseTupleAndKeywords(args, kwds, "O|ipO", (char**)kwlist,
+                                     &obj, &connectivity, &topology,
+                                     &maskObj))
+        return -1;
+    if(((PyCC*)self)->cc) { // Views of current C&C may exist
+        PyErr_SetString(PyExc_RuntimeError, "C&C already initialized");
+        return -1;
+    }
+    if(connectivity!=0 && connectivity!=4 && connectivity!=8) {
+        PyErr_SetString(PyExc_ValueError, "connectivity must be 0, 4 or 8");
+        return -1;
+    }
+    opt.connectivity = connectivity==4? CC_LOWER4:
+        connectivity==8? CC_LOWER8: CC_BILINEAR;
+    opt.topology = (topology != 0);
+    Py_buffer b;
+    if(PyObject_GetBuffer(obj, &b, PyBUF_C_CONTIGUOUS|PyBUF_FORMAT) < 0)
+        return -1;
+    if(b.ndim != 2 || b.shape[0] > 32767 || b.shape[1] > 32767) {
+        PyBuffer_Release(&b);
+        PyErr_SetString(PyExc_ValueError, "image must be 2D, at most 32767");
+        return -1;
+    }
+    Py_buffer m;
+    m.buf = 0;
+    const bool hasMask = (maskObj != Py_None);
+    if(hasMask) {
+        if(PyObject_GetBuffer(maskObj, &m, PyBUF_C_CONTIGUOUS|PyBUF_FORMAT)<0){
+            PyBuffer_Release(&b);
+            return -1;
+        }
+        const char* f = format(m);
+        if(m.ndim!=2 || m.shape[0]!=b.shape[0] || m.shape[1]!=b.shape[1] ||
+           m.itemsize!=1 || (f[0]!='B' && f[0]!='?')) {
+            PyBuffer_Release(&m);
+            PyBuffer_Release(&b);
+            PyErr_SetString(PyExc_ValueError,
+                            "mask must be uint8/bool of same shape as image");
+            return -1;
+        }
+    }
+    const unsigned char* mask = (const unsigned char*)m.buf;
+    const char* f = format(b);
+    CC* cc = 0;
+    bool noMemory=false, typeOk=true;
+    if(f[0]=='f' && b.itemsize==4)
+        cc = build<float>(b, opt, mask, noMemory);
+    else if(f[0]=='B' && b.itemsize==1)
+        cc = build<unsigned char>(b, opt, mask, noMemory);
+    else if(f[0]=='H' && b.itemsize==2)
+        cc = build<unsigned short>(b, opt, mask, noMemory);
+    else
+        typeOk = false;
+    if(hasMask)
+        PyBuffer_Release(&m);
+    PyBuffer_Release(&b);
+    if(noMemory) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if(! typeOk) {
+        PyErr_SetString(PyExc_TypeError, "image must be float32/uint8/uint16");
+        return -1;
+    }
+    ((PyCC*)self)->cc = cc;
+    return 0;
+}
+
+static void cc_dealloc(PyObject* self) {
+    delete ((PyCC*)self)->cc;
+    Py_TYPE(self)->tp_free(self);
+}
+
+static CC* get_cc(PyObject* self) {
+    CC* cc = ((PyCC*)self)->cc;
+    if(! cc)
+        PyErr_SetString(PyExc_RuntimeError, "C&C not initialized");
+    return cc;
+}
+
+/// Offset in bytes of member \a m in struct \a S.
+template <typename S, typename T>
+static size_t offset(const S& s, T S::* m) {
+    return (const char*)&(s.*m) - (const char*)&s;
+}
+
+/// View of one member of all contours, the virtual saddles included.
+template <typename T>
+static PyObject* contour_view(PyObject* self, T Contour::* m,
+                              const char* format) {
+    CC* cc = get_cc(self);
+    if(! cc)
+        return NULL;
+    return make_view(self, (char*)cc->contours.data()+offset(Contour(),m),
+                     format, sizeof(T), cc->contours.size(), sizeof(Contour));
+}
+
+/// View of one member of all continua.
+static PyObject* continuum_view(PyObject* self, int Continuum::* m) {
+    CC* cc = get_cc(self);
+    if(! cc)
+        return NULL;
+    return make_view(self, (char*)cc->continua.data()+offset(Continuum(0,0),m),
+                     "i", sizeof(int), cc->continua.size(), sizeof(Continuum));
+}
+
+static PyObject* cc_levels(PyObject* self, void*) {
+    return contour_view(self, &Contour::lvl, "f");
+}
+static PyObject* cc_contour_parent(PyObject* self, void*) {
+    return contour_view(self, &Contour::parent, "i");
+}
+static PyObject* cc_inf(PyObject* self, void*) {
+    return continuum_view(self, &Continuum::infCtr);
+}
+static PyObject* cc_sup(PyObject* self, void*) {
+    return continuum_view(self, &Continuum::supCtr);
+}
+static PyObject* cc_continuum_parent(PyObject* self, void*) {
+    return continuum_view(self, &Continuum::parent);
+}
+static PyObject* cc_size(PyObject* self, void*) {
+    CC* cc = get_cc(self);
+    return cc? Py_BuildValue("(ii)", cc->h, cc->w): NULL;
+}
+
+/// Continuum of index given in \a args, NULL with exception if invalid.
+static Continuum* get_continuum(PyObject* self, PyObject* args) {
+    int i;
+    CC* cc = get_cc(self);
+    if(! cc || ! PyArg_ParseTuple(args, "i", &i))
+        return NULL;
+    if(i<0 || i>=(int)cc->continua.size()) {
+        PyErr_SetString(PyExc_IndexError, "continuum index out of range");
+        return NULL;
+    }
+    return &cc->continua[i];
+}
+
+/// mme(i): the packed monotone mesh elements of continuum i, array of uint32.
+static PyObject* cc_mme(PyObject* self, PyObject* args) {
+    Continuum* c = get_continuum(self, args);
+    if(! c)
+        return NULL;
+    return make_view(self, c->mme.data(), "I", sizeof(unsigned int),
+                     c->mme.size(), sizeof(Mme));
+}
+
+/// mme_points(i): top-left corners of mme of continuum i, new list of (x,y).
+static PyObject* cc_mme_points(PyObject* self, PyObject* args) {
+    Continuum* c = get_continuum(self, args);
+    if(! c)
+        return NULL;
+    CC* cc = ((PyCC*)self)->cc;
+    PyObject* l = PyList_New(c->mme.size());
+    if(! l)
+        return NULL;
+    for(size_t j=0; j<c->mme.size(); j++) {
+        DPoint p = cc->point(c->mme[j]);
+        PyObject* t = Py_BuildValue("(dd)", p.x, p.y);
+        if(! t) {
+            Py_DECREF(l);
+            return NULL;
+        }
+        PyList_SET_ITEM(l, j, t);
+    }
+    return l;
+}
+
+/// root_continuum(i): canonical continuum of the one of index i.
+static PyObject* cc_root_continuum(PyObject* self, PyObject* args) {
+    int i;
+    CC* cc = get_cc(self);
+    if(! cc || ! PyArg_ParseTuple(args, "i", &i))
+        return NULL;
+    if(i<0 || i>=(int)cc->continua.size()) {
+        PyErr_SetString(PyExc_IndexError, "continuum index out of range");
+        return NULL;
+    }
+    return PyLong_FromLong(cc->root_continuum(i));
+}
+
+static PyGetSetDef cc_getset[] = {
+    {(char*)"levels", cc_levels, NULL,
+     (char*)"level of each contour (pixels, then saddles)", NULL},
+    {(char*)"contour_parent", cc_contour_parent, NULL,
+     (char*)"merge parent of each contour (-1 for root)", NULL},
+    {(char*)"inf", cc_inf, NULL, (char*)"inf contour of each continuum", NULL},
+    {(char*)"sup", cc_sup, NULL, (char*)"sup contour of each continuum", NULL},
+    {(char*)"continuum_parent", cc_continuum_parent, NULL,
+     (char*)"merge parent of each continuum (-1 for root)", NULL},
+    {(char*)"shape", cc_size, NULL, (char*)"(h,w) of image", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyMethodDef cc_methods[] = {
+    {"mme", cc_mme, METH_VARARGS,
+     "packed mme of continuum i: cell<<2 | saddle x<<1 | saddle y"},
+    {"mme_points", cc_mme_points, METH_VARARGS,
+     "top-left corners (x,y) of mme of continuum i"},
+    {"root_continuum", cc_root_continuum, METH_VARARGS,
+     "canonical continuum of continuum i"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject PyCCType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+static PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "shapevision",
+    "Contours & continua of bilinear images", -1, NULL,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_shapevision(void) {
+    PyCCViewType.tp_name = "shapevision._View";
+    PyCCViewType.tp_basicsize = sizeof(PyCCView);
+    PyCCViewType.tp_dealloc = view_dealloc;
+    PyCCViewType.tp_as_buffer = &view_as_buffer;
+    PyCCViewType.tp_flags = Py_TPFLAGS_DEFAULT;
+    if(PyType_Ready(&PyCCViewType) < 0)
+        return NULL;
+
+    PyCCType.tp_name = "shapevision.CC";
+    PyCCType.tp_doc = "CC(image, connectivity=0, topology=False, mask=None): "
+        "contours & continua of 2D array";
+    PyCCType.tp_basicsize = sizeof(PyCC);
+    PyCCType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PyCCType.tp_new = PyType_GenericNew;
+    PyCCType.tp_init = cc_init;
+    PyCCType.tp_dealloc = cc_dealloc;
+    PyCCType.tp_getset = cc_getset;
+    PyCCType.tp_methods = cc_methods;
+    if(PyType_Ready(&PyCCType) < 0)
+        return NULL;
+
+    PyObject* m = PyModule_Create(&module);
+    if(! m)
+        return NULL;
+    Py_INCREF(&PyCCType);
+    if(PyModule_AddObject(m, "CC", (PyObject*)&PyCCType) < 0) {
+        Py_DECREF(&PyCCType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
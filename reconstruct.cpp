@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file reconstruct.cpp
+ * @brief Simplified image from contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "reconstruct.h"
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+/// Build the inclusion tree of \a cc and the attributes of its shapes. The
+/// persistence of a shape is the largest difference of level between a node
+/// of its subtree and its parent. Children follow their parent in preorder,
+/// so a reverse pass accumulates subtrees.
+CCReconstruct::CCReconstruct(CC& cc)
+: w(cc.w), h(cc.h), tree(cc), hasArea(! cc.opt.topology) {
+    const int n = tree.size();
+    level.resize(n);
+    for(int i=0; i<n; i++)
+        level[i] = cc.contours[tree.contour[i]].lvl;
+    std::vector<float> lo(level), hi(level); // Level range of subtree
+    persistence.assign(n, 0);
+    area.assign(n, 0);
+    for(int i=n-1; i>=0; i--) {
+        int p = tree.parent[i];
+        if(p < 0)
+            continue;
+        if(hasArea)
+            area[i] += cc.continua[tree.continuum[i]].attr.area;
+        persistence[i] = std::max(hi[i]-level[p], level[p]-lo[i]);
+        area[p] += area[i];
+        lo[p] = std::min(lo[p],lo[i]);
+        hi[p] = std::max(hi[p],hi[i]);
+    }
+}
+
+/// Write in \a out (w x h) the image where shapes of persistence below
+/// \a minPers or area below \a minArea are removed. Rows are distributed
+/// over \a nThreads threads (0=number of cores). Return false, with \a out
+/// untouched, if \a minArea is positive but areas are unknown.
+bool CCReconstruct::filter(float minPers, double minArea, float* out,
+                           int nThreads) const {
+    if(minArea>0 && ! hasArea)
+        return false;
+    const int n = tree.size();
+    std::vector<float> lvl(level), shift(n,0); // Output level, offset to input
+    for(int i=0; i<n; i++) { // Preorder: parent done before child
+        int p = tree.parent[i];
+        if(p < 0)
+            continue;
+        if(persistence[i]<minPers || area[i]<minArea) {
+            lvl[i] = lvl[p];
+            shift[i] = lvl[p]-level[i];
+        } else {
+            shift[i] = shift[p];
+            lvl[i] = level[i]+shift[i];
+        }
+    }
+    if(nThreads <= 0)
+        nThreads = (int)std::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads,h));
+    auto worker = [&](int t) {
+        for(int y=t*h/nThreads; y<(t+1)*h/nThreads; y++) {
+            const int* node = &tree.ctrNode[(size_t)y*w];
+            float* row = out+(size_t)y*w;
+            for(int x=0; x<w; x++)
+                row[x] = lvl[node[x]];
+        }
+    };
+    std::vector<std::thread> threads;
+    for(int t=1; t<nThreads; t++)
+        threads.push_back(std::thread(worker,t));
+    worker(0);
+    for(size_t t=0; t<threads.size(); t++)
+        threads[t].join();
+    return true;
+}
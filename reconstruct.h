@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file reconstruct.h
+ * @brief Simplified image from contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef RECONSTRUCT_H
+#define RECONSTRUCT_H
+
+#include "tree.h"
+
+/// Reconstruction of the image without the shapes of low persistence or
+/// small area. The shape of a node of the inclusion tree is its subtree with
+/// the continuum linking it to its parent: it spans from the extrema inside
+/// to the contour where it merges with its parent. A removed shape takes the
+/// level of its parent, the shapes it contains keep their offset to it.
+/// Invalid pixels (see CC) remain NaN. The tree is built once, so that each
+/// new pair of thresholds costs only a pass over nodes and pixels.
+struct CCReconstruct {
+    const int w,h;
+    CCTree tree;
+    std::vector<float> level; ///< Level of each node
+    std::vector<float> persistence; ///< Of shape of node
+    std::vector<double> area; ///< Of shape of node
+    bool hasArea; ///< Areas are not computed in topology mode
+
+    explicit CCReconstruct(CC& cc);
+    bool filter(float minPers, double minArea, float* out,
+                int nThreads=0) const;
+};
+
+#endif
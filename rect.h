@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file rect.h
+ * @brief Rectangles of the pyramid of construction of contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * Internal to the library, shared by the construction and the merge of
+ * tile summaries.
+ */
+
+#ifndef RECT_H
+#define RECT_H
+
+#include "cc.h"
+#include <list>
+#include <vector>
+
+/// Rectangle of dual pixels with the chain codes of its four sides (0=top,
+/// 1=right, 2=bottom, 3=left), one per edge of dual pixel: alternating
+/// contours and continua crossing the edge. Outside the domain of a masked
+/// image, chain codes are empty, and so is a side entirely outside.
+struct Rect {
+    Pos tl, br; ///< Top-left and bottom-right corners of rectangle
+    std::list<std::list<int>> chainCode[4];
+    Rect(Pos topLeft, Pos bottomRight);
+    template <typename I> Rect(CC& cc, Pos p, float lvl[4], I);
+};
+
+Rect merge_rectangles(CC& cc, Rect& R1, Rect& R2);
+void report_finalized(CC& cc, CCContext* ctx, const std::vector<Rect>& R,
+                      std::vector<bool>& done);
+
+#endif
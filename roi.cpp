@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file roi.cpp
+ * @brief Contours & Continua of a region of interest of an image
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "roi.h"
+#include <algorithm>
+
+/// Enlarge the region of interest of top-left \a tl and bottom-right \a br
+/// (excluded) by \a halo pixels on each side and clip it to the image.
+void CCRoi::window(Pos& tl, Pos& br, int halo, int w, int h) {
+    tl.x = std::max(tl.x-halo, 0);  tl.y = std::max(tl.y-halo, 0);
+    br.x = std::min(br.x+halo, w);  br.y = std::min(br.y+halo, h);
+}
+
+/// Build the C&C of window \a win of top-left \a tl and bottom-right \a br
+/// (excluded) in the image of size \a w x \a h. A continuum is truncated if
+/// one of its mme is a dual pixel at a side of the window that is not at
+/// the boundary of the image.
+CCRoi::CCRoi(const float* win, Pos tl, Pos br, int w, int h,
+             const CCOptions& opt, CCContext* ctx)
+: tl(tl), br(br), w(w), h(h) {
+    int ww=br.x-tl.x, wh=br.y-tl.y;
+    cc = new CC(win, ww, wh, opt, ctx);
+    truncated.assign(cc->continua.size(), false);
+    const int left  = (tl.x>0)? 0: -1, right  = (br.x<w)? ww-2: -1;
+    const int top   = (tl.y>0)? 0: -1, bottom = (br.y<h)? wh-2: -1;
+    for(size_t i=0; i<cc->continua.size(); i++) {
+        const std::vector<Mme>& mme = cc->continua[i].mme; // Empty if merged
+        for(size_t j=0; j<mme.size() && !truncated[i]; j++) {
+            int x=mme[j].cell()%ww, y=mme[j].cell()/ww;
+            truncated[i] = (x==left || x==right || y==top || y==bottom);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file roi.h
+ * @brief Contours & Continua of a region of interest of an image
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef ROI_H
+#define ROI_H
+
+#include "cc.h"
+#include <vector>
+
+/// C&C of a window of an image, usually a region of interest enlarged by a
+/// halo. Only the pixels of the window are needed, so that the cost is the
+/// one of the window. Continua reaching the frame of the window inside the
+/// image may extend outside and are marked truncated.
+struct CCRoi {
+    Pos tl, br; ///< Window in the image, br excluded
+    int w,h; ///< Size of the full image
+    CC* cc; ///< C&C of the window, in coordinates of the window
+    std::vector<bool> truncated; ///< For each root continuum
+
+    CCRoi(const float* win, Pos tl, Pos br, int w, int h,
+          const CCOptions& opt=CCOptions(), CCContext* ctx=0);
+    ~CCRoi() { delete cc; }
+    bool is_truncated(int i) { return truncated[cc->root_continuum(i)]; }
+
+    static void window(Pos& tl, Pos& br, int halo, int w, int h);
+
+    CCRoi(const CCRoi&) = delete;
+    CCRoi& operator=(const CCRoi&) = delete;
+};
+
+#endif
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file server.cpp
+ * @brief Long-running server computing C&C of images sent on a channel
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "server.h"
+#include <vector>
+#include <memory>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/// Latencies of requests, shared by workers.
+class Stats {
+    std::mutex m;
+    std::vector<double> lat; ///< Latencies (ms) of last requests
+    size_t n; ///< Total number of requests
+    static const size_t MAX_SAMPLES = 100000;
+public:
+    Stats(): n(0) {}
+    void add(double ms) {
+        std::lock_guard<std::mutex> lock(m);
+        if(lat.size() < MAX_SAMPLES)
+            lat.push_back(ms);
+        else
+            lat[n%MAX_SAMPLES] = ms;
+        ++n;
+    }
+    std::string report() {
+        std::vector<double> v;
+        size_t total;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            v = lat;
+            total = n;
+        }
+        std::ostringstream str;
+        str << "requests " << total << '\n';
+        if(v.empty())
+            return str.str();
+        std::sort(v.begin(), v.end());
+        const int pc[] = {50, 90, 99};
+        for(int p: pc)
+            str << 'p' << p << ' ' << v[(v.size()-1)*p/100] << " ms\n";
+        str << "max " << v.back() << " ms\n";
+        return str.str();
+    }
+};
+
+/// Buffers of a worker, kept from one request to the next.
+struct Workspace {
+    std::vector<char> in;
+    std::vector<uint32_t> out;
+};
+
+static bool read_full(int fd, void* buf, size_t n) {
+    char* p = (char*)buf;
+    while(n > 0) {
+        ssize_t k = read(fd, p, n);
+        if(k <= 0)
+            return false;
+        p += k; n -= k;
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void* buf, size_t n) {
+    const char* p = (const char*)buf;
+    while(n > 0) {
+        ssize_t k = write(fd, p, n);
+        if(k <= 0)
+            return false;
+        p += k; n -= k;
+    }
+    return true;
+}
+
+static bool answer(int fd, uint32_t status, const void* buf, size_t n) {
+    uint32_t head[2] = {status, (uint32_t)n};
+    return write_full(fd, head, sizeof(head)) && write_full(fd, buf, n);
+}
+
+/// Read and discard \a n bytes of \a fd.
+static bool skip(int fd, size_t n) {
+    char buf[4096];
+    while(n > 0) {
+        size_t k = std::min(n, sizeof(buf));
+        if(! read_full(fd, buf, k))
+            return false;
+        n -= k;
+    }
+    return true;
+}
+
+/// Answer an error with message \a msg.
+static bool answer_error(int fd, const std::string& msg) {
+    return answer(fd, 1, msg.c_str(), msg.size());
+}
+
+/// Read the image of a compute request and build its C&C. The payload is
+/// the number of root continua, then their inf and sup levels. An error is
+/// answered if memory is exhausted or if construction takes more than
+/// \a timeout ms (0 for no limit), and the channel stays usable.
+static bool compute(int fdIn, int fdOut, Workspace& ws, const CCOptions& opt,
+                    double timeout) {
+    uint32_t head[3]; // w, h, sample type
+    if(! read_full(fdIn, head, sizeof(head)))
+        return false;
+    const size_t sizes[] = {sizeof(float), 1, 2};
+    if(head[0]==0 || head[1]==0 || head[0]>32767 || head[1]>32767 ||
+       head[2]>2) {
+        answer_error(fdOut, "invalid image header");
+        return false; // Unable to skip the samples
+    }
+    int w=(int)head[0], h=(int)head[1];
+    size_t n = (size_t)w*h*sizes[head[2]];
+    try {
+        ws.in.resize(n);
+    } catch(const std::bad_alloc&) {
+        return skip(fdIn, n) && answer_error(fdOut, "out of memory");
+    }
+    if(! read_full(fdIn, ws.in.data(), n))
+        return false;
+    CCContext ctx;
+    if(timeout > 0)
+        ctx.set_timeout(timeout);
+    std::unique_ptr<CC> cc;
+    try {
+        switch(head[2]) {
+        case 0: cc.reset(new CC((const float*)ws.in.data(), w, h, opt, &ctx));
+            break;
+        case 1: cc.reset(new CC((const unsigned char*)ws.in.data(), w, h, opt,
+                                &ctx));
+            break;
+        case 2: cc.reset(new CC((const unsigned short*)ws.in.data(), w, h,
+                                opt, &ctx));
+            break;
+        }
+        if(cc->status != CC_OK)
+            return answer_error(fdOut, "timeout");
+        uint32_t nRoots=0;
+        for(size_t i=0; i<cc->continua.size(); i++)
+            if(cc->continua[i].parent < 0)
+                ++nRoots;
+        ws.out.reserve(1+2*(size_t)nRoots);
+        ws.out.assign(1, nRoots);
+        for(size_t i=0; i<cc->continua.size(); i++) {
+            const Continuum& c = cc->continua[i];
+            if(c.parent >= 0)
+                continue;
+            float lvl[2] = {cc->contours[cc->root_contour(c.infCtr)].lvl,
+                            cc->contours[cc->root_contour(c.supCtr)].lvl};
+            uint32_t u[2];
+            std::memcpy(u, lvl, sizeof(u));
+            ws.out.push_back(u[0]);
+            ws.out.push_back(u[1]);
+        }
+    } catch(const std::bad_alloc&) {
+        cc.reset();
+        return answer_error(fdOut, "out of memory");
+    }
+    cc.reset();
+    return answer(fdOut, 0, ws.out.data(), ws.out.size()*sizeof(uint32_t));
+}
+
+/// Serve requests read on \a fdIn, answers written on \a fdOut, until the
+/// channel is closed or a quit command is received.
+static void serve(int fdIn, int fdOut, Workspace& ws, Stats& stats,
+                  const CCOptions& opt, double timeout) {
+    uint32_t cmd;
+    while(read_full(fdIn, &cmd, sizeof(cmd))) {
+        std::chrono::steady_clock::time_point t0 =
+            std::chrono::steady_clock::now();
+        if(cmd == 'C') {
+            if(! compute(fdIn, fdOut, ws, opt, timeout))
+                return;
+            std::chrono::duration<double,std::milli> d =
+                std::chrono::steady_clock::now() - t0;
+            stats.add(d.count());
+        } else if(cmd == 'S') {
+            std::string s = stats.report();
+            if(! answer(fdOut, 0, s.c_str(), s.size()))
+                return;
+        } else {
+            if(cmd != 'Q') {
+                answer_error(fdOut, "unknown command");
+            }
+            return;
+        }
+    }
+}
+
+/// Serve requests on streams of file descriptors, typically stdin/stdout.
+int serve_stream(int fdIn, int fdOut, const CCOptions& opt, double timeout) {
+    Workspace ws;
+    Stats stats;
+    serve(fdIn, fdOut, ws, stats, opt, timeout);
+    return 0;
+}
+
+/// Listen on Unix domain socket at \a path. Each of the \a nThreads workers
+/// (0=number of cores) accepts connections and serves them in turn.
+int serve_socket(const std::string& path, int nThreads, const CCOptions& opt,
+                 double timeout) {
+    sockaddr_un addr;
+    if(path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        std::cerr << "Unable to create socket" << std::endl;
+        return 1;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    unlink(path.c_str());
+    if(bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        std::cerr << "Unable to listen on socket " << path << std::endl;
+        close(fd);
+        return 1;
+    }
+    if(nThreads <= 0)
+        nThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    signal(SIGPIPE, SIG_IGN); // Client closing early must not kill us
+    Stats stats;
+    auto worker = [&]() {
+        Workspace ws;
+        for(;;) {
+            int client = accept(fd, 0, 0);
+            if(client < 0) {
+                if(errno == EINTR)
+                    continue;
+                break;
+            }
+            serve(client, client, ws, stats, opt, timeout);
+            close(client);
+        }
+    };
+    std::vector<std::thread> threads;
+    for(int i=1; i<nThreads; i++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for(size_t i=0; i<threads.size(); i++)
+        threads[i].join();
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file server.h
+ * @brief Long-running server computing C&C of images sent on a channel
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * Protocol: all integers are 32-bit unsigned in native byte order.
+ * A request starts with a command:
+ * - 'C' compute: followed by w, h, sample type (0=float, 1=8 bit,
+ *   2=16 bit) and the w*h samples. The answer payload is the number of
+ *   root continua followed by their pairs (inf,sup) of float levels. An
+ *   error is answered if memory is exhausted or if construction exceeds
+ *   the time limit of the server.
+ * - 'S' stats: the answer payload is a text with number of requests and
+ *   percentiles of latency.
+ * - 'Q' quit: the server closes the channel.
+ * An answer is a status (0=ok, 1=error), the byte length of the payload and
+ * the payload.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "cc.h"
+#include <string>
+
+/// \a timeout is the max time of construction of a request in ms (0=none)
+int serve_stream(int fdIn, int fdOut, const CCOptions& opt, double timeout=0);
+int serve_socket(const std::string& path, int nThreads, const CCOptions& opt,
+                 double timeout=0);
+
+#endif
@@ -9,8 +9,29 @@
 #include "cmdLine.h"
 #include "io_png.h"
 #include "cc.h"
+#include "preview.h"
+#include "planes.h"
+#include "roi.h"
+#include "reconstruct.h"
+#include "tile.h"
+#include "trace.h"
+#include "server.h"
+#include <unistd.h>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
 using namespace std;
 
+/// Progress report of construction.
+static void print_progress(int level, int nLevels, void*) {
+    cerr << "Level " << level+1 << '/' << nLevels << endl;
+}
+
+/// Count continua closed by a merge of tiles.
+static void count_finalized(CC&, int, void* data) {
+    ++*(int*)data;
+}
+
 /** \mainpage ShapeVision.
   * Persistence maps of image obtained by bilinear interpolation of the samples.
 */
@@ -18,6 +39,69 @@ int main(int argc, char* argv[]) {
     // parse arguments
     CmdLine cmd;
 
+    int preview=0;
+    CCOptions opt;
+    cmd.add( make_option('p', preview, "preview")
+             .doc("max pixels of coarse C&C (0=full resolution)") );
+    int connectivity=0;
+    cmd.add( make_option(0, connectivity, "connectivity")
+             .doc("of lower level sets, 4 or 8 (0=bilinear)") );
+    std::string maskFile;
+    cmd.add( make_option(0, maskFile, "mask")
+             .doc("PNG of valid pixels, non-zero (NaN samples are invalid)") );
+    cmd.add( make_switch('c', "channels")
+             .doc("C&C of each channel instead of gray image") );
+    double timeout=0;
+    cmd.add( make_option(0, timeout, "timeout")
+             .doc("max time of construction in ms (0=none)") );
+    cmd.add( make_switch('v', "verbose")
+             .doc("report progress of construction") );
+    std::string traceFile;
+    cmd.add( make_option(0, traceFile, "trace")
+             .doc("write timeline of construction (trace-event JSON)") );
+    std::string checkpoint, resumed;
+    double period=0;
+    cmd.add( make_option(0, checkpoint, "checkpoint")
+             .doc("save state of construction in file between levels") );
+    cmd.add( make_option(0, period, "checkpoint-period")
+             .doc("min seconds between checkpoints") );
+    cmd.add( make_option(0, resumed, "resume")
+             .doc("resume construction from checkpoint file") );
+    std::string out;
+    float minPers=0;
+    double minArea=0;
+    io_png_opt png;
+    io_png_opt_default(&png);
+    cmd.add( make_option('o', out, "output")
+             .doc("simplified image (.png, or .raw for float samples)") );
+    cmd.add( make_option('f', minPers, "min-persistence")
+             .doc("remove shapes of lower persistence in output") );
+    cmd.add( make_option('a', minArea, "min-area")
+             .doc("remove shapes of smaller area in output") );
+    cmd.add( make_option(0, png.level, "png-level")
+             .doc("zlib compression level of output, 0..9") );
+    cmd.add( make_option(0, png.depth, "png-depth")
+             .doc("bit depth of output, 8 or 16") );
+    cmd.add( make_option(0, png.strips, "png-strips")
+             .doc("nb strips of output compressed in parallel") );
+    std::string roi;
+    int halo=0;
+    cmd.add( make_option('r', roi, "roi")
+             .doc("region of interest x,y,w,h: decode and compute only it") );
+    cmd.add( make_option(0, halo, "halo")
+             .doc("margin of pixels around region of interest") );
+    std::string tile, merged;
+    cmd.add( make_option('T', tile, "tile")
+             .doc("with -r, save summary of region as tile in file") );
+    cmd.add( make_option('m', merged, "merge")
+             .doc("merge summaries of adjacent tiles into file") );
+    std::string server;
+    int nThreads=0;
+    cmd.add( make_option('s', server, "server")
+             .doc("serve requests on Unix socket (-=stdin/stdout)") );
+    cmd.add( make_option('t', nThreads, "threads")
+             .doc("nb worker threads of server (0=automatic)") );
+
     /*    int nScales=0;
     float grad=0;
     
@@ -33,21 +117,209 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error: " << s << std::endl;
         return 1;
     }
-    if(argc != 2) {
+    if(connectivity!=0 && connectivity!=4 && connectivity!=8) {
+        cerr << "Invalid connectivity " << connectivity << endl;
+        return 1;
+    }
+    opt.connectivity = connectivity==4? CC_LOWER4:
+        connectivity==8? CC_LOWER8: CC_BILINEAR;
+    if(timeout > 0 && (cmd.used('c') || cmd.used('p'))) {
+        cerr << "Option --timeout is not supported with -c or -p" << endl;
+        return 1;
+    }
+    if(! maskFile.empty() && (cmd.used('r') || cmd.used('c') ||
+                              cmd.used('p') || cmd.used('m') ||
+                              cmd.used('s') || ! resumed.empty())) {
+        cerr << "Option --mask is not supported with -r, -c, -p, -m, -s or "
+             << "--resume" << endl;
+        return 1;
+    }
+    if(cmd.used('s') && argc == 1) {
+        if(server == "-")
+            return serve_stream(STDIN_FILENO, STDOUT_FILENO, opt, timeout);
+        return serve_socket(server, nThreads, opt, timeout);
+    }
+    if(cmd.used('m') && argc == 3) {
+        CCTile a, b;
+        if(! a.load(argv[1]) || ! b.load(argv[2])) {
+            cerr << "Unable to load tile summaries" << endl;
+            return 1;
+        }
+        int nClosed=0;
+        CCContext ctx;
+        if(timeout > 0)
+            ctx.set_timeout(timeout);
+        ctx.finalized = count_finalized;
+        ctx.data = &nClosed;
+        CC* cc = merge_tiles(a, b, &ctx);
+        if(! cc) {
+            cerr << "Tiles are not adjacent or built with different options"
+                 << endl;
+            return 1;
+        }
+        if(cc->status != CC_OK) {
+            cerr << "Merge timed out" << endl;
+            delete cc;
+            return 1;
+        }
+        Pos tl(std::min(a.tl.x,b.tl.x), std::min(a.tl.y,b.tl.y));
+        CCTile t(*cc, tl, a.w, a.h);
+        delete cc;
+        if(! t.save(merged)) {
+            cerr << "Unable to write tile summary " << merged << endl;
+            return 1;
+        }
+        cout << "Tile " << t.br.x-t.tl.x+1 << 'x' << t.br.y-t.tl.y+1 << '+'
+             << t.tl.x << '+' << t.tl.y << ": " << nClosed
+             << " continua closed, " << t.continua.size() << " on frame"
+             << endl;
+        return 0;
+    }
+    if(argc != 2 && !(argc == 1 && ! resumed.empty())) {
         cerr << "Usage: " << argv[0] << " [options] imgIn.png\n"
+             << "   or: " << argv[0] << " [options] -s socket\n"
+             << "   or: " << argv[0] << " [options] -m out tile1 tile2\n"
+             << "   or: " << argv[0] << " [options] --resume checkpoint\n"
              << cmd;
         return 1;
     }
 
-    size_t w, h;
-    float* im = io_png_read_f32_gray(argv[1], &w, &h);
+    if(cmd.used('r') && argc == 2) {
+        int x,y,rw,rh;
+        char c1,c2,c3;
+        std::istringstream str(roi);
+        if(!(str>>x>>c1>>y>>c2>>rw>>c3>>rh) || c1!=',' || c2!=',' || c3!=','
+           || x<0 || y<0 || rw<=0 || rh<=0 || halo<0 ||
+           rw>32767-x || rh>32767-y) { // Pos coordinates are short
+
+            cerr << "Invalid region of interest " << roi << endl;
+            return 1;
+        }
+        Pos tl(x,y), br(x+rw,y+rh);
+        CCRoi::window(tl, br, halo, 32767, 32767); // Image size still unknown
+        size_t w, h, nx=br.x-tl.x, ny=br.y-tl.y;
+        float* win = io_png_read_f32_gray_roi(argv[1], tl.x, tl.y, &nx, &ny,
+                                              &w, &h);
+        if(! win) {
+            cerr << "Unable to load region of image " << argv[1] << endl;
+            return 1;
+        }
+        br = Pos(tl.x+nx, tl.y+ny);
+        opt.keepFrame = cmd.used('T');
+        CCContext ctx;
+        if(timeout > 0)
+            ctx.set_timeout(timeout);
+        CCRoi r(win, tl, br, (int)w, (int)h, opt, &ctx);
+        if(r.cc->status != CC_OK) {
+            cerr << "Construction timed out" << endl;
+            free(win);
+            return 1;
+        }
+        if(cmd.used('T')) {
+            if(! r.cc->frame || ! CCTile(*r.cc,tl,(int)w,(int)h).save(tile)) {
+                cerr << "Unable to write tile summary " << tile << endl;
+                free(win);
+                return 1;
+            }
+        }
+        int n=0, nTrunc=0;
+        for(size_t i=0; i<r.cc->continua.size(); i++)
+            if(r.cc->continua[i].parent < 0) {
+                ++n;
+                nTrunc += r.truncated[i];
+            }
+        cout << "Window " << nx << 'x' << ny << '+' << tl.x << '+' << tl.y
+             << ": " << n << " continua, " << nTrunc << " truncated" << endl;
+        free(win);
+        return 0;
+    }
+
+    std::unique_ptr<CCTrace> trace;
+    if(! traceFile.empty())
+        trace.reset(new CCTrace);
+    CCContext ctx;
+    if(timeout > 0)
+        ctx.set_timeout(timeout);
+    if(cmd.used('v'))
+        ctx.progress = print_progress;
+    ctx.trace = trace.get();
+    ctx.checkpoint = checkpoint;
+    ctx.checkpointPeriod = period;
+
+    size_t w, h, nc=1;
+    float* im;
+    std::unique_ptr<CC> cc;
+    if(argc == 1) {
+        cc.reset(CC::resume(resumed, &ctx));
+        if(! cc) {
+            cerr << "Unable to resume from checkpoint " << resumed << endl;
+            return 1;
+        }
+        w = cc->w; h = cc->h;
+        im = (float*)malloc(w*h*sizeof(float)); // Output only
+    } else
+        im = cmd.used('c')? io_png_read_f32_planar(argv[1], &w, &h, &nc):
+            io_png_read_f32_gray(argv[1], &w, &h);
     if(! im) {
         cerr << "Unable to load image " << argv[1] << endl;
         return 1;
     }
 
-    CC cc(im,(int)w,(int)h); // Will do something with it later...
+    if(nc > 1) {
+        CCPlanes planes(im,(int)w,(int)h,(int)nc,opt,0,trace.get());
+        for(size_t i=0; i<nc; i++)
+            cout << "Channel " << i << ": "
+                 << planes[i].continua.size() << " continua" << endl;
+    } else if(preview > 0 && ! cc) {
+        CCPreview p(im,(int)w,(int)h,preview,opt);
+        cout << "Preview at scale 1/" << p.scale << ": "
+             << p.coarse->continua.size() << " continua" << endl;
+    } else {
+        if(! cc) {
+            unsigned char* mask=0;
+            size_t mw=0, mh=0;
+            if(! maskFile.empty() &&
+               (!(mask=io_png_read_u8_gray(maskFile.c_str(), &mw, &mh)) ||
+                mw!=w || mh!=h)) {
+                cerr << "Invalid mask " << maskFile << endl;
+                free(mask);
+                free(im);
+                return 1;
+            }
+            cc.reset(new CC(im,(int)w,(int)h,opt,&ctx,mask));
+            free(mask);
+        }
+        if(cc->status != CC_OK) {
+            cerr << "Construction "
+                 << (cc->status==CC_TIMEOUT? "timed out": "cancelled") << endl;
+            free(im);
+            return 1;
+        }
+        if(cmd.used('o')) {
+            CCReconstruct rec(*cc);
+            if(! rec.filter(minPers, minArea, im)) { // Original not needed
+                cerr << "Areas are not computed in topology mode" << endl;
+                free(im);
+                return 1;
+            }
+            bool raw = out.size()>4 && out.compare(out.size()-4,4,".raw")==0;
+            if(! raw) // NaN of invalid pixels has no PNG value
+                for(size_t i=0; i<w*h; i++)
+                    if(std::isnan(im[i]))
+                        im[i] = 0;
+            if((raw? io_raw_write_f32(out.c_str(), im, w, h, 1):
+                io_png_write_f32_opt(out.c_str(), im, w, h, 1, &png)) != 0) {
+                cerr << "Unable to write image " << out << endl;
+                free(im);
+                return 1;
+            }
+        }
+    }
 
     free(im);
+    if(trace && ! trace->write(traceFile)) {
+        cerr << "Unable to write trace " << traceFile << endl;
+        return 1;
+    }
     return 0;
 }
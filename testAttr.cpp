@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testAttr.cpp
+ * @brief Attributes of continua against their recomputation from the mme
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "cc.h"
+#include "testImage.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+/// Whether \a a and \a b are equal up to rounding errors of sums.
+static bool close(double a, double b) {
+    return std::abs(a-b) <= 1e-9*std::max(1.0,std::abs(a));
+}
+
+/// Length of the edge shared by rectangles [p1,q1] and [p2,q2], 0 if none.
+static double shared_edge(const DPoint& p1, const DPoint& q1,
+                          const DPoint& p2, const DPoint& q2) {
+    double dx = std::min(q1.x,q2.x)-std::max(p1.x,p2.x);
+    double dy = std::min(q1.y,q2.y)-std::max(p1.y,p2.y);
+    if(dx==0 && dy>0)
+        return dy;
+    if(dy==0 && dx>0)
+        return dx;
+    return 0;
+}
+
+/// Compare the attributes of root continua of \a cc, accumulated during
+/// propagation, with their recomputation from the chain of mme.
+/// Return the number of failures.
+static int check(CC& cc, const char* name) {
+    int fail=0;
+    for(size_t i=0; i<cc.continua.size(); i++) {
+        const Continuum& c = cc.continua[i];
+        if(c.parent >= 0)
+            continue;
+        CCAttr a = cc.mme_attr(c.mme.front());
+        for(size_t k=1; k<c.mme.size(); k++) {
+            CCAttr b = cc.mme_attr(c.mme[k]);
+            DPoint p=cc.point(c.mme[k-1]), q=cc.mme_br(p);
+            a.chainLength += b.chainLength - 2*shared_edge(p,q, b.tl,b.br);
+            a.area += b.area;
+            a.sumLvl += b.sumLvl;
+            a.tl.x = std::min(a.tl.x,b.tl.x); a.tl.y = std::min(a.tl.y,b.tl.y);
+            a.br.x = std::max(a.br.x,b.br.x); a.br.y = std::max(a.br.y,b.br.y);
+        }
+        const CCAttr& e = c.attr;
+        if(!close(a.area,e.area) || !close(a.sumLvl,e.sumLvl) ||
+           !close(a.chainLength,e.chainLength) ||
+           a.tl!=e.tl || a.br!=e.br) {
+            std::cerr << name << ": attributes of continuum " << i
+                      << " differ from its mme" << std::endl;
+            ++fail;
+        }
+    }
+    return fail;
+}
+
+/// Attributes of the continua of an image with plateaus, for each
+/// connectivity, and of an image with isolated extrema.
+int main() {
+    const int w=37, h=29;
+    const std::vector<float> im = waves(w, h);
+    int fail=0;
+    CCOptions opt;
+    CC upper(im.data(), w, h, opt);
+    fail += check(upper, "upper8");
+    opt.connectivity = CC_LOWER8;
+    CC lower(im.data(), w, h, opt);
+    fail += check(lower, "lower8");
+    std::vector<float> noise(w*h);
+    for(int i=0; i<w*h; i++)
+        noise[i] = (float)((i*7919)%101);
+    CC cc(noise.data(), w, h);
+    fail += check(cc, "noise");
+    return fail? 1: 0;
+}
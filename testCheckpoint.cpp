@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testCheckpoint.cpp
+ * @brief Construction resumed from a checkpoint against an uninterrupted one
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "cc.h"
+#include "testImage.h"
+#include <iostream>
+#include <cstdio>
+
+/// Whether \a a and \a b have the same contours and continua.
+static bool same(CC& a, CC& b) {
+    if(a.contours.size()!=b.contours.size() ||
+       a.continua.size()!=b.continua.size() || a.saddles!=b.saddles)
+        return false;
+    for(size_t i=0; i<a.contours.size(); i++)
+        if(a.root_contour((int)i)!=b.root_contour((int)i) ||
+           a.contours[i].lvl!=b.contours[i].lvl ||
+           a.contours[i].p!=b.contours[i].p)
+            return false;
+    for(size_t i=0; i<a.continua.size(); i++) {
+        const Continuum &x=a.continua[i], &y=b.continua[i];
+        if(a.root_continuum((int)i)!=b.root_continuum((int)i) ||
+           x.infCtr!=y.infCtr || x.supCtr!=y.supCtr ||
+           x.mme.size()!=y.mme.size() || x.attr.area!=y.attr.area ||
+           x.attr.chainLength!=y.attr.chainLength ||
+           x.attr.sumLvl!=y.attr.sumLvl)
+            return false;
+        for(size_t k=0; k<x.mme.size(); k++)
+            if(x.mme[k].code != y.mme[k].code)
+                return false;
+    }
+    return true;
+}
+
+/// Construction to interrupt at the end of a level
+struct Run {
+    CCContext* ctx;
+    int stopLevel; ///< Level after which construction is cancelled
+    int nFinalized; ///< Continua reported as finalized
+};
+
+static void progress(int level, int, void* data) {
+    Run* r = static_cast<Run*>(data);
+    if(level == r->stopLevel)
+        r->ctx->cancelled = true;
+}
+
+static void finalized(CC&, int, void* data) {
+    ++static_cast<Run*>(data)->nFinalized;
+}
+
+/// Cancel the construction of \a im after each level in turn and resume it
+/// from the checkpoint. The C&C must be the one of an uninterrupted
+/// construction, each continuum being reported as finalized once over both
+/// runs. Return the number of failures.
+static int check(const std::vector<float>& im, int w, int h,
+                 const CCOptions& opt, const char* name) {
+    const char* file = "testCheckpoint.ccc";
+    CCContext ctx;
+    Run ref = {&ctx, -1, 0};
+    ctx.finalized = finalized;
+    ctx.data = &ref;
+    CC cc(im.data(), w, h, opt, &ctx);
+    int fail=0;
+    for(int level=1; ; level++) {
+        std::remove(file);
+        CCContext ctx1;
+        Run r = {&ctx1, level, 0};
+        ctx1.progress = progress;
+        ctx1.finalized = finalized;
+        ctx1.data = &r;
+        ctx1.checkpoint = file;
+        {
+            CC a(im.data(), w, h, opt, &ctx1);
+            if(a.status == CC_OK) // Not interrupted, last level reached
+                break;
+        }
+        CCContext ctx2;
+        ctx2.finalized = finalized;
+        ctx2.data = &r;
+        CC* b = CC::resume(file, &ctx2);
+        if(! b || b->status!=CC_OK || ! same(cc,*b) ||
+           r.nFinalized!=ref.nFinalized) {
+            std::cerr << name << ": resumed after level " << level
+                      << " differs" << std::endl;
+            ++fail;
+        }
+        delete b;
+    }
+    std::remove(file);
+    return fail;
+}
+
+/// Image of waves, with plateaus and ties of levels.
+int main() {
+    const int w=45, h=31;
+    const std::vector<float> im = waves(w, h);
+    int fail=0;
+    CCOptions opt;
+    fail += check(im, w, h, opt, "bilinear");
+    opt.connectivity = CC_LOWER4;
+    fail += check(im, w, h, opt, "lower4");
+    return fail? 1: 0;
+}
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testDiagram.cpp
+ * @brief Distances of persistence diagrams computed by hand
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "diagram.h"
+#include <iostream>
+#include <cmath>
+
+/// Check distance of \a a and \a b of exponent \a q (0=bottleneck) against
+/// \a expected, exactly and by approximation. Return number of failures.
+static int check(const char* name, const PDiagram& a, const PDiagram& b,
+                 double q, double expected) {
+    int fail=0;
+    PDOptions opt;
+    opt.q = q;
+    for(int exact=1; exact>=0; exact--) {
+        opt.exact = (exact==1);
+        double tol = opt.exact? 1e-9: opt.relErr*expected+1e-9;
+        double d[2] = {pd_distance(a,b,opt), pd_distance(b,a,opt)};
+        for(double v: d)
+            if(std::abs(v-expected) > tol) {
+                std::cerr << name << (q==0? " bottleneck": " W") << q
+                          << (opt.exact? " exact": " approximate") << ": "
+                          << v << ", expected " << expected << std::endl;
+                ++fail;
+            }
+    }
+    return fail;
+}
+
+int main() {
+    int fail=0;
+    // Single points, closer to each other than to the diagonal
+    PDiagram a1 = {PDPoint(0,4)}, b1 = {PDPoint(1,4)};
+    fail += check("single", a1, b1, 1, 1);
+    fail += check("single", a1, b1, 0, 1);
+    // Extra point of low persistence matched to the diagonal
+    PDiagram a2 = {PDPoint(0,4), PDPoint(0,1)}, b2 = {PDPoint(0,4)};
+    fail += check("extra", a2, b2, 1, 0.5);
+    fail += check("extra", a2, b2, 2, 0.5);
+    fail += check("extra", a2, b2, 0, 0.5);
+    // (0,10)-(1,9) at 1, (2,3) and (5,5.5) to the diagonal at 0.5 and 0.25
+    PDiagram a3 = {PDPoint(0,10), PDPoint(2,3)};
+    PDiagram b3 = {PDPoint(1,9), PDPoint(5,5.5)};
+    fail += check("pairs", a3, b3, 1, 1.75);
+    fail += check("pairs", a3, b3, 2, std::sqrt(1+0.25+0.0625));
+    fail += check("pairs", a3, b3, 0, 1);
+    // Empty diagram: all points to the diagonal
+    PDiagram a4 = {PDPoint(0,2), PDPoint(1,5)}, b4;
+    fail += check("empty", a4, b4, 1, 3);
+    fail += check("empty", a4, b4, 0, 2);
+    // Batched distances equal to single ones
+    std::vector<PDiagram> db = {b1, b2, b3, b4};
+    PDOptions opt;
+    std::vector<double> d = pd_distances(a3, db, opt, 2);
+    for(size_t i=0; i<db.size(); i++)
+        if(d[i] != pd_distance(a3, db[i], opt)) {
+            std::cerr << "Batched distance " << i << ": " << d[i]
+                      << ", expected " << pd_distance(a3, db[i], opt)
+                      << std::endl;
+            ++fail;
+        }
+    return fail? 1: 0;
+}
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testImage.h
+ * @brief Synthetic images shared by the tests
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef TESTIMAGE_H
+#define TESTIMAGE_H
+
+#include <vector>
+#include <cmath>
+
+/// Image \a w x \a h of quantized waves, with plateaus and ties of levels.
+inline std::vector<float> waves(int w, int h) {
+    std::vector<float> im(w*h);
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++)
+            im[y*w+x] = std::floor(4*std::sin(0.4*x)*std::cos(0.3*y)+0.1*x);
+    return im;
+}
+
+#endif
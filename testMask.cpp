@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testMask.cpp
+ * @brief Construction on a masked domain against the one of a crop
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "cc.h"
+#include "testImage.h"
+#include <iostream>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <limits>
+
+/// Continuum as levels of its inf and sup contours and codes of its mme,
+/// with cells in coordinates of the image.
+typedef std::pair<std::pair<float,float>,std::vector<unsigned>> Key;
+typedef std::multiset<Key> Keys;
+
+/// Root continua of \a cc, whose pixel (0,0) is at \a o in the image of
+/// width \a w.
+static Keys continua(CC& cc, Pos o, int w) {
+    Keys keys;
+    for(size_t i=0; i<cc.continua.size(); i++) {
+        const Continuum& c = cc.continua[i];
+        if(c.parent >= 0)
+            continue;
+        Key k;
+        k.first.first = cc.contours[cc.root_contour(c.infCtr)].lvl;
+        k.first.second = cc.contours[cc.root_contour(c.supCtr)].lvl;
+        for(Mme m: c.mme) {
+            int x=m.cell()%cc.w+o.x, y=m.cell()/cc.w+o.y;
+            k.second.push_back(Mme(y*w+x, m.saddleX(), m.saddleY()).code);
+        }
+        std::sort(k.second.begin(), k.second.end());
+        keys.insert(k);
+    }
+    return keys;
+}
+
+/// Compare \a cc, built on the domain [x0,x1]x[y0,y1] of the image, with
+/// \a crop, built on the crop of the image to the domain: same continua,
+/// same levels and same partition of pixels in contours inside the domain,
+/// level NaN outside. Return the number of failures.
+static int check(CC& cc, CC& crop, int x0, int x1, int y0, int y1,
+                 const char* name) {
+    int fail=0;
+    if(continua(cc,Pos(0,0),cc.w) != continua(crop,Pos(x0,y0),cc.w)) {
+        std::cerr << name << ": continua differ from crop" << std::endl;
+        ++fail;
+    }
+    std::map<int,int> root; // Root contour in crop -> in cc
+    for(int y=0; y<cc.h; y++)
+        for(int x=0; x<cc.w; x++) {
+            float l = cc.contours[cc.idx(x,y)].lvl;
+            if(x<x0 || x>x1 || y<y0 || y>y1) {
+                if(! std::isnan(l)) {
+                    std::cerr << name << ": level at (" << x << ',' << y
+                              << ") outside domain" << std::endl;
+                    ++fail;
+                }
+                continue;
+            }
+            int i = crop.idx(x-x0,y-y0);
+            int r = cc.root_contour(cc.idx(x,y));
+            if(l != crop.contours[i].lvl ||
+               root.insert(std::make_pair(crop.root_contour(i),r)).first
+               ->second != r) {
+                std::cerr << name << ": contour at (" << x << ',' << y
+                          << ") differs from crop" << std::endl;
+                ++fail;
+            }
+        }
+    std::set<int> roots; // Distinct contours of crop are distinct in cc
+    for(const std::pair<const int,int>& r: root)
+        roots.insert(r.second);
+    if(roots.size() != root.size()) {
+        std::cerr << name << ": contours of crop merged" << std::endl;
+        ++fail;
+    }
+    return fail;
+}
+
+/// Image whose domain is a rectangle not aligned with the pyramid, so that
+/// chain codes are empty at its boundary and rectangles of the pyramid lie
+/// entirely outside. It is defined by a mask, then by NaN samples.
+int main() {
+    const int w=40, h=30, x0=5, x1=26, y0=7, y1=22;
+    const std::vector<float> im = waves(w, h);
+    std::vector<float> sub, nan(im);
+    std::vector<unsigned char> mask(w*h, 0);
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++)
+            if(x0<=x && x<=x1 && y0<=y && y<=y1) {
+                sub.push_back(im[y*w+x]);
+                mask[y*w+x] = 1;
+            } else
+                nan[y*w+x] = std::numeric_limits<float>::quiet_NaN();
+    int fail=0;
+    CC crop(sub.data(), x1-x0+1, y1-y0+1);
+    CC masked(im.data(), w, h, CCOptions(), 0, mask.data());
+    fail += check(masked, crop, x0, x1, y0, y1, "mask");
+    CC invalid(nan.data(), w, h);
+    fail += check(invalid, crop, x0, x1, y0, y1, "NaN");
+    return fail? 1: 0;
+}
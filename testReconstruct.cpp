@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testReconstruct.cpp
+ * @brief Simplified image of a ramp and of a noisy step
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "reconstruct.h"
+#include <iostream>
+#include <set>
+#include <cmath>
+
+/// Image \a im (\a w x \a h) filtered with thresholds \a minPers and
+/// \a minArea.
+static std::vector<float> filter(const std::vector<float>& im, int w, int h,
+                                 float minPers, double minArea) {
+    CC cc(im.data(), w, h);
+    CCReconstruct rec(cc);
+    std::vector<float> out(w*h);
+    rec.filter(minPers, minArea, out.data());
+    return out;
+}
+
+/// Number of leaves of the inclusion tree of image \a im (\a w x \a h),
+/// that is of its regional extrema.
+static int leaves(const std::vector<float>& im, int w, int h) {
+    CC cc(im.data(), w, h);
+    CCTree tree(cc);
+    int n=0;
+    for(int i=0; i<tree.size(); i++)
+        if(tree.firstChild[i] < 0)
+            ++n;
+    return n;
+}
+
+/// Whether filtering the ramp \a im (\a w x \a h) changes no pixel by
+/// \a tol or more and keeps at least \a nLevels distinct levels.
+static bool ramp_kept(const std::vector<float>& im, int w, int h,
+                      float minPers, double minArea, float tol, int nLevels) {
+    std::vector<float> out = filter(im, w, h, minPers, minArea);
+    std::set<float> levels(out.begin(), out.end());
+    for(int i=0; i<w*h; i++)
+        if(std::abs(out[i]-im[i]) >= tol)
+            return false;
+    return (int)levels.size() >= nLevels;
+}
+
+/// A ramp is made of nested shapes of high persistence and large area: only
+/// its extremum is clipped. In a noisy step, most extrema are removed while
+/// the two sides keep their levels.
+int main() {
+    const int w=159, h=10;
+    std::vector<float> ramp(w*h);
+    for(int i=0; i<w*h; i++)
+        ramp[i] = (float)(i%w);
+    int fail=0;
+    if(! ramp_kept(ramp,w,h, 2,0, 2, w-2)) {
+        std::cerr << "Ramp flattened by persistence" << std::endl;
+        ++fail;
+    }
+    if(! ramp_kept(ramp,w,h, 0,50, 7, w-7)) {
+        std::cerr << "Ramp flattened by area" << std::endl;
+        ++fail;
+    }
+
+    const int sw=40, sh=30;
+    std::vector<float> step(sw*sh), clean(sw*sh);
+    unsigned seed=1;
+    for(int i=0; i<sw*sh; i++) { // Noise in [-2,2] from a LCG
+        seed = seed*1103515245+12345;
+        clean[i] = (i%sw<sw/2)? 0: 100;
+        step[i] = clean[i] + (float)((seed>>16)%5)-2;
+    }
+    const int n = leaves(step,sw,sh);
+    for(int k=0; k<2; k++) {
+        std::vector<float> out = k? filter(step,sw,sh, 0,100):
+                                    filter(step,sw,sh, 10,0);
+        bool kept=true;
+        for(int i=0; i<sw*sh; i++)
+            kept = kept && std::abs(out[i]-clean[i])<=2;
+        if(! kept || leaves(out,sw,sh) > n/(k? 2: 4)) {
+            std::cerr << "Step not denoised by "
+                      << (k? "area": "persistence") << std::endl;
+            ++fail;
+        }
+    }
+    return fail? 1: 0;
+}
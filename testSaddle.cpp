@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testSaddle.cpp
+ * @brief Regression test of the saddle point of a dual pixel
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "cc.h"
+#include <iostream>
+
+/// Dual pixel with levels a=0, b=3 (top row), d=2, c=1 (bottom row). The
+/// bilinear image a(1-x)(1-y)+bx(1-y)+cxy+d(1-x)y has its saddle point at
+/// x=(a-d)/(a+c-b-d)=0.5, y=(a-b)/(a+c-b-d)=0.75, of level 1.5. The cell is
+/// asymmetric, so that transposed coordinates are detected.
+int main() {
+    float v[4] = {0, 3,
+                  2, 1};
+    CC cc(v, 2, 2);
+    const Contour& s = cc.contours[4]; // Saddle of the single dual pixel
+    if(s.p.x!=0.5 || s.p.y!=0.75 || s.lvl!=1.5) {
+        std::cerr << "Saddle at (" << s.p.x << ',' << s.p.y << ") level "
+                  << s.lvl << ", expected (0.5,0.75) level 1.5" << std::endl;
+        return 1;
+    }
+    return 0;
+}
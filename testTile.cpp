@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file testTile.cpp
+ * @brief Merge of tiles against a single construction of the C&C
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "tile.h"
+#include "testImage.h"
+#include <iostream>
+#include <cstdio>
+#include <set>
+#include <algorithm>
+
+/// Continuum as levels of its inf and sup contours and codes of its mme,
+/// with cells in coordinates of the image.
+typedef std::pair<std::pair<float,float>,std::vector<unsigned>> Key;
+typedef std::multiset<Key> Keys;
+
+/// Where finalized continua of a tile are collected.
+struct Collect {
+    Pos o; ///< Pixel (0,0) of the C&C in the image
+    int w; ///< Width of the image
+    Keys* keys;
+};
+
+/// Add the finalized continuum \a i of \a cc to the keys of \a data.
+static void finalized(CC& cc, int i, void* data) {
+    Collect* c = static_cast<Collect*>(data);
+    const Continuum& ctn = cc.continua[i];
+    Key k;
+    k.first.first = cc.contours[cc.root_contour(ctn.infCtr)].lvl;
+    k.first.second = cc.contours[cc.root_contour(ctn.supCtr)].lvl;
+    for(Mme m: ctn.mme) {
+        int x=m.cell()%cc.w+c->o.x, y=m.cell()/cc.w+c->o.y;
+        k.second.push_back(Mme(y*c->w+x, m.saddleX(), m.saddleY()).code);
+    }
+    std::sort(k.second.begin(), k.second.end());
+    c->keys->insert(k);
+}
+
+/// Summary of the tile [x0,x1]x[y0,y1] of image \a im of width \a w, height
+/// \a h, whose finalized continua are added to \a keys. It is saved to and
+/// loaded from a file to exercise the format.
+static CCTile tile(const std::vector<float>& im, int w, int h,
+                   int x0, int x1, int y0, int y1, Keys& keys) {
+    const int tw=x1-x0+1, th=y1-y0+1;
+    std::vector<float> crop(tw*th);
+    for(int y=0; y<th; y++)
+        for(int x=0; x<tw; x++)
+            crop[y*tw+x] = im[(y+y0)*w+x+x0];
+    CCContext ctx;
+    Collect c = {Pos(x0,y0), w, &keys};
+    ctx.finalized = finalized;
+    ctx.data = &c;
+    CCOptions opt;
+    opt.keepFrame = true;
+    CC cc(crop.data(), tw, th, opt, &ctx);
+    const char* file = "testTile.cct";
+    CCTile t;
+    if(! CCTile(cc, Pos(x0,y0), w, h).save(file) || ! t.load(file))
+        std::cerr << "Save or load of tile failed" << std::endl;
+    std::remove(file);
+    return t;
+}
+
+/// Merge of \a a and \a b, whose finalized continua are added to \a keys.
+static CC* merge(const CCTile& a, const CCTile& b, int w, Keys& keys) {
+    CCContext ctx;
+    Pos o(std::min(a.tl.x,b.tl.x), std::min(a.tl.y,b.tl.y));
+    Collect c = {o, w, &keys};
+    ctx.finalized = finalized;
+    ctx.data = &c;
+    return merge_tiles(a, b, &ctx);
+}
+
+/// Image built as a single C&C and as 2x2 tiles merged by rows then by
+/// columns. The continua must be the same, those of the final frame
+/// included.
+int main() {
+    const int w=37, h=29, mx=17, my=12;
+    const std::vector<float> im = waves(w, h);
+    Keys single, tiled;
+    {
+        CCContext ctx;
+        Collect c = {Pos(0,0), w, &single};
+        ctx.finalized = finalized;
+        ctx.data = &c;
+        CC cc(im.data(), w, h, CCOptions(), &ctx);
+    }
+    const int xs[3]={0,mx,w-1}, ys[3]={0,my,h-1};
+    CCTile t[2][2], row[2];
+    for(int i=0; i<2; i++)
+        for(int j=0; j<2; j++)
+            t[i][j] = tile(im,w,h, xs[j],xs[j+1], ys[i],ys[i+1], tiled);
+    for(int i=0; i<2; i++) {
+        CC* cc = merge(t[i][1], t[i][0], w, tiled); // Any order
+        if(! cc) {
+            std::cerr << "Tiles of row " << i << " not merged" << std::endl;
+            return 1;
+        }
+        row[i] = CCTile(*cc, t[i][0].tl, w, h);
+        delete cc;
+    }
+    CC* cc = merge(row[0], row[1], w, tiled);
+    if(! cc) {
+        std::cerr << "Rows not merged" << std::endl;
+        return 1;
+    }
+    CCTile all(*cc, Pos(0,0), w, h);
+    delete cc;
+    for(const TileContinuum& c: all.continua) {
+        Key k;
+        k.first.first = all.contours[c.infCtr].lvl;
+        k.first.second = all.contours[c.supCtr].lvl;
+        for(Mme m: c.mme)
+            k.second.push_back(m.code);
+        std::sort(k.second.begin(), k.second.end());
+        tiled.insert(k);
+    }
+    int fail=0;
+    if(single != tiled) {
+        std::cerr << "Continua: " << single.size() << " single, "
+                  << tiled.size() << " tiled" << std::endl;
+        ++fail;
+    }
+    // Tiles built with different options are not merged
+    t[0][1].connectivity = CC_LOWER8;
+    if((cc = merge(t[0][0], t[0][1], w, tiled)) != 0) {
+        std::cerr << "Tiles of different options merged" << std::endl;
+        delete cc;
+        ++fail;
+    }
+    return fail? 1: 0;
+}
@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file tile.cpp
+ * @brief Mergeable summaries of contours & continua of tiles of an image
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * Summaries are saved in a portable binary format, little-endian:
+ * - "CCT2", then tl, br, w, h, connectivity, topology as int32;
+ * - number of contours, then for each one a saddle flag as uint8, its level
+ *   as float32 and its position as two float64;
+ * - number of continua, then for each one its inf and sup contours as
+ *   uint32, its attributes (area, sumLvl, chainLength, tl, br) as 7
+ *   float64, its number of mme and their codes as uint32;
+ * - for each of the 4 sides, the number of edges, then for each edge the
+ *   length of its chain code and its indexes as uint32. The chain code is
+ *   empty if the edge is outside the domain of a masked image.
+ */
+
+#include "tile.h"
+#include "rect.h"
+#include "binio.h"
+#include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+/// Summary of the C&C \a cc of the tile whose pixel (0,0) is \a tl in an
+/// image of size \a w x \a h. The C&C must have kept its frame.
+CCTile::CCTile(CC& cc, Pos tl, int w, int h)
+: w(w), h(h), connectivity(cc.opt.connectivity), topology(cc.opt.topology) {
+    assert(cc.frame);
+    const Rect& R = *cc.frame;
+    this->tl = Pos(tl.x+R.tl.x, tl.y+R.tl.y);
+    br = Pos(tl.x+R.br.x, tl.y+R.br.y);
+    std::vector<int> ctr(cc.contours.size(),-1), ctn(cc.continua.size(),-1);
+    std::vector<int> src; // Continuum of cc of each one of summary
+    auto contour = [&](int i) {
+        if(ctr[i] < 0) {
+            ctr[i] = (int)contours.size();
+            TileContour c;
+            const DPoint& p = cc.contours[i].p;
+            c.saddle = (cc.saddle((int)p.x,(int)p.y) == i);
+            c.lvl = cc.contours[i].lvl;
+            c.p = DPoint(p.x+tl.x, p.y+tl.y);
+            contours.push_back(c);
+        }
+        return ctr[i];
+    };
+    auto continuum = [&](int i) {
+        i = cc.root_continuum(i);
+        if(ctn[i] < 0) {
+            ctn[i] = (int)continua.size();
+            continua.push_back(TileContinuum());
+            src.push_back(i);
+        }
+        return ctn[i];
+    };
+    for(int s=0; s<4; s++) {
+        for(const std::list<int>& L: R.chainCode[s]) {
+            std::vector<int> e;
+            for(std::list<int>::const_iterator it=L.begin(); it!=L.end(); ++it)
+                e.push_back((e.size()&1)? continuum(*it):
+                            contour(cc.root_contour(*it)));
+            frame[s].push_back(e);
+        }
+        if(frame[s].empty()) // Side outside domain
+            frame[s].resize((s&1)? R.br.y-R.tl.y: R.br.x-R.tl.x);
+    }
+    for(size_t k=0; k<src.size(); k++) {
+        const Continuum& c = cc.continua[src[k]];
+        TileContinuum& t = continua[k];
+        t.infCtr = contour(cc.root_contour(c.infCtr));
+        t.supCtr = contour(cc.root_contour(c.supCtr));
+        t.mme.reserve(c.mme.size());
+        for(size_t j=0; j<c.mme.size(); j++) {
+            Mme m = c.mme[j];
+            int x=m.cell()%cc.w, y=m.cell()/cc.w;
+            if(cc.saddle(x,y) >= 0) // Needed to decode the mme
+                contour(cc.saddle(x,y));
+            t.mme.push_back(Mme((y+tl.y)*w+x+tl.x, m.saddleX(), m.saddleY()));
+        }
+        t.attr = c.attr;
+        t.attr.tl.x += tl.x; t.attr.tl.y += tl.y;
+        t.attr.br.x += tl.x; t.attr.br.y += tl.y;
+    }
+}
+
+/// Add contours and continua of summary \a t to the sparse C&C \a cc, whose
+/// pixel (0,0) is at \a o in the image. The contour of each pixel already
+/// added, shared by adjacent tiles, is in \a pixels. Return the rectangle of
+/// the tile in \a cc.
+static Rect add_tile(CC& cc, const CCTile& t, Pos o,
+                     std::unordered_map<int,int>& pixels) {
+    std::vector<int> ctr(t.contours.size());
+    for(size_t k=0; k<t.contours.size(); k++) {
+        const TileContour& c = t.contours[k];
+        DPoint p(c.p.x-o.x, c.p.y-o.y);
+        int i = cc.idx((int)p.x,(int)p.y);
+        ctr[k] = (int)cc.contours.size();
+        if(c.saddle)
+            cc.sparseSaddles[i] = ctr[k];
+        else {
+            std::pair<std::unordered_map<int,int>::iterator,bool> ins =
+                pixels.insert(std::make_pair(i, ctr[k]));
+            if(! ins.second) { // Pixel shared with the other tile
+                ctr[k] = ins.first->second;
+                continue;
+            }
+        }
+        cc.contours.push_back(Contour());
+        cc.contours.back().p = p;
+        cc.contours.back().lvl = c.lvl;
+    }
+    const int base = (int)cc.continua.size();
+    for(size_t k=0; k<t.continua.size(); k++) {
+        const TileContinuum& c = t.continua[k];
+        Continuum d(ctr[c.infCtr], ctr[c.supCtr]);
+        d.mme.reserve(c.mme.size());
+        for(size_t j=0; j<c.mme.size(); j++) {
+            Mme m = c.mme[j];
+            int x=m.cell()%t.w-o.x, y=m.cell()/t.w-o.y;
+            d.mme.push_back(Mme(cc.idx(x,y), m.saddleX(), m.saddleY()));
+        }
+        d.attr = c.attr;
+        d.attr.tl.x -= o.x; d.attr.tl.y -= o.y;
+        d.attr.br.x -= o.x; d.attr.br.y -= o.y;
+        cc.continua.push_back(std::move(d));
+    }
+    Rect R(Pos(t.tl.x-o.x,t.tl.y-o.y), Pos(t.br.x-o.x,t.br.y-o.y));
+    for(int s=0; s<4; s++)
+        for(const std::vector<int>& e: t.frame[s]) {
+            std::list<int> L;
+            for(size_t i=0; i<e.size(); i++)
+                L.push_back((i&1)? base+e[i]: ctr[e[i]]);
+            R.chainCode[s].push_back(L);
+        }
+    return R;
+}
+
+/// C&C of the union of adjacent tiles \a a and \a b of the same image, from
+/// their summaries, as in a single construction. Its pixel (0,0) is the
+/// top-left one of the union and it keeps its frame, so that it can be
+/// summarized in turn. It is sparse, with only the contours and continua of
+/// the summaries, so that its memory does not grow with the area of the
+/// union. Continua closed by the merge are reported to \a ctx as finalized.
+/// Return 0 if the tiles are not adjacent or not built with the same
+/// options.
+CC* merge_tiles(const CCTile& a, const CCTile& b, CCContext* ctx) {
+    const CCTile *t1=&a, *t2=&b; // t1 left of or above t2
+    if(b.tl.x < a.tl.x || b.tl.y < a.tl.y)
+        std::swap(t1, t2);
+    bool horizontal = t1->tl.y==t2->tl.y && t1->br.y==t2->br.y &&
+        t1->br.x==t2->tl.x;
+    bool vertical = t1->tl.x==t2->tl.x && t1->br.x==t2->br.x &&
+        t1->br.y==t2->tl.y;
+    if(a.w!=b.w || a.h!=b.h || a.connectivity!=b.connectivity ||
+       a.topology!=b.topology || !(horizontal || vertical))
+        return 0;
+    const Pos o = t1->tl;
+    CCOptions opt;
+    opt.keepFrame = true;
+    opt.connectivity = a.connectivity;
+    opt.topology = a.topology;
+    CC* cc = new CC(t2->br.x-o.x+1, t2->br.y-o.y+1, opt, ctx, false);
+    cc->contours.reserve(a.contours.size()+b.contours.size());
+    std::unordered_map<int,int> pixels;
+    Rect R1=add_tile(*cc,*t1,o,pixels), R2=add_tile(*cc,*t2,o,pixels);
+    std::vector<Rect> R(1, merge_rectangles(*cc, R1, R2));
+    if(cc->interrupted(true))
+        return cc;
+    std::vector<bool> done;
+    report_finalized(*cc, ctx, R, done);
+    cc->frame.reset(new Rect(std::move(R[0])));
+    return cc;
+}
+
+/// Write summary in file \a fileName. Return whether it succeeded.
+bool CCTile::save(const std::string& fileName) const {
+    std::ofstream s(fileName.c_str(), std::ios::binary);
+    s.write("CCT2", 4);
+    const int head[] = {tl.x, tl.y, br.x, br.y, w, h, (int)connectivity,
+                        topology? 1: 0};
+    for(int v: head)
+        put32(s, (uint32_t)v);
+    put32(s, (uint32_t)contours.size());
+    for(const TileContour& c: contours) {
+        s.put(c.saddle? 1: 0);
+        put_float(s, c.lvl);
+        put_double(s, c.p.x);
+        put_double(s, c.p.y);
+    }
+    put32(s, (uint32_t)continua.size());
+    for(const TileContinuum& c: continua) {
+        put32(s, (uint32_t)c.infCtr);
+        put32(s, (uint32_t)c.supCtr);
+        const double attr[] = {c.attr.area, c.attr.sumLvl,
+                               c.attr.chainLength, c.attr.tl.x, c.attr.tl.y,
+                               c.attr.br.x, c.attr.br.y};
+        for(double v: attr)
+            put_double(s, v);
+        put32(s, (uint32_t)c.mme.size());
+        for(const Mme& m: c.mme)
+            put32(s, m.code);
+    }
+    for(int i=0; i<4; i++) {
+        put32(s, (uint32_t)frame[i].size());
+        for(const std::vector<int>& e: frame[i]) {
+            put32(s, (uint32_t)e.size());
+            for(int v: e)
+                put32(s, (uint32_t)v);
+        }
+    }
+    return (bool)s;
+}
+
+/// Read summary from file \a fileName. Return whether it succeeded and is
+/// consistent, otherwise the summary is left empty.
+bool CCTile::load(const std::string& fileName) {
+    *this = CCTile();
+    std::ifstream s(fileName.c_str(), std::ios::binary);
+    char magic[4] = {0,0,0,0};
+    s.read(magic, 4);
+    if(std::memcmp(magic, "CCT2", 4) != 0)
+        return false;
+    int head[8];
+    for(int& v: head)
+        v = (int)get32(s);
+    if(!s || head[4]<=0 || head[5]<=0 || head[4]>32767 || head[5]>32767 ||
+       head[0]<0 || head[1]<0 || head[2]>=head[4] || head[3]>=head[5] ||
+       head[0]>=head[2] || head[1]>=head[3] ||
+       head[6]<CC_BILINEAR || head[6]>CC_LOWER8 || head[7]<0 || head[7]>1)
+        return false;
+    tl = Pos(head[0],head[1]); br = Pos(head[2],head[3]);
+    w = head[4]; h = head[5];
+    connectivity = (CCConnectivity)head[6];
+    topology = (head[7] != 0);
+    for(uint32_t n=get32(s); s && contours.size()<n; ) {
+        TileContour c;
+        c.saddle = (s.get() != 0);
+        c.lvl = get_float(s);
+        c.p.x = get_double(s);
+        c.p.y = get_double(s);
+        if(!(tl.x<=c.p.x && c.p.x<=br.x && tl.y<=c.p.y && c.p.y<=br.y))
+            s.setstate(std::ios::failbit);
+        contours.push_back(c);
+    }
+    const uint32_t nCtr = (uint32_t)contours.size();
+    for(uint32_t n=get32(s); s && continua.size()<n; ) {
+        TileContinuum c;
+        c.infCtr = (int)get32(s);
+        c.supCtr = (int)get32(s);
+        double* attr[] = {&c.attr.area, &c.attr.sumLvl, &c.attr.chainLength,
+                          &c.attr.tl.x, &c.attr.tl.y, &c.attr.br.x,
+                          &c.attr.br.y};
+        for(double* v: attr)
+            *v = get_double(s);
+        for(uint32_t k=get32(s); s && c.mme.size()<k; ) {
+            Mme m;
+            m.code = get32(s);
+            if(m.cell() >= w*h)
+                s.setstate(std::ios::failbit);
+            c.mme.push_back(m);
+        }
+        if((uint32_t)c.infCtr>=nCtr || (uint32_t)c.supCtr>=nCtr)
+            s.setstate(std::ios::failbit);
+        continua.push_back(std::move(c));
+    }
+    for(int i=0; i<4 && s; i++) {
+        const uint32_t len = (i&1)? br.y-tl.y: br.x-tl.x;
+        if(get32(s) != len)
+            s.setstate(std::ios::failbit);
+        for(uint32_t j=0; j<len && s; j++) {
+            std::vector<int> e;
+            for(uint32_t k=get32(s); s && e.size()<k; ) {
+                uint32_t v = get32(s);
+                if(v >= ((e.size()&1)? (uint32_t)continua.size(): nCtr))
+                    s.setstate(std::ios::failbit);
+                e.push_back((int)v);
+            }
+            if(!e.empty() && !(e.size()&1)) // Starts and ends with a contour
+                s.setstate(std::ios::failbit);
+            frame[i].push_back(e);
+        }
+    }
+    if(! s)
+        *this = CCTile();
+    return (bool)s;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file tile.h
+ * @brief Mergeable summaries of contours & continua of tiles of an image
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef TILE_H
+#define TILE_H
+
+#include "cc.h"
+#include <string>
+#include <vector>
+
+/// Contour referenced by a tile summary, in coordinates of the image.
+struct TileContour {
+    bool saddle; ///< Saddle of a dual pixel, otherwise a pixel
+    float lvl;
+    DPoint p; ///< Position of the pixel or of the saddle
+    TileContour(): saddle(false), lvl(0) {}
+};
+
+/// Continuum referenced by a tile summary. Contours are indexes in the
+/// summary, cells of mme and attributes are in coordinates of the image.
+struct TileContinuum {
+    int infCtr, supCtr;
+    std::vector<Mme> mme;
+    CCAttr attr;
+    TileContinuum(): infCtr(-1), supCtr(-1) {}
+};
+
+/// Summary of the C&C of a tile of an image: the chain codes of its frame
+/// and the contours and continua they reference, with the saddles of their
+/// mme. It is all that is needed to merge the tile with adjacent ones, the
+/// other continua being final. Adjacent tiles share a row or column of
+/// pixels. The C&C of the tile must be built with option keepFrame.
+struct CCTile {
+    Pos tl, br; ///< Pixels at corners of the tile in the image, br included
+    int w,h; ///< Size of the image
+    CCConnectivity connectivity; ///< Option of construction of the tile
+    bool topology; ///< Option of construction of the tile
+    std::vector<TileContour> contours;
+    std::vector<TileContinuum> continua;
+    /// Chain codes of each side, one per edge of dual pixel, alternating
+    /// indexes in contours and in continua
+    std::vector<std::vector<int>> frame[4];
+
+    CCTile(): w(0), h(0), connectivity(CC_BILINEAR), topology(false) {}
+    CCTile(CC& cc, Pos tl, int w, int h);
+
+    bool save(const std::string& fileName) const;
+    bool load(const std::string& fileName);
+};
+
+CC* merge_tiles(const CCTile& a, const CCTile& b, CCContext* ctx=0);
+
+#endif
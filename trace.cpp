@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file trace.cpp
+ * @brief Timeline of construction of C&C in trace-event format
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "trace.h"
+#include <atomic>
+#include <cstdio>
+
+/// Number of traces created, to identify them
+static std::atomic<unsigned int> nTraces(0);
+
+/// Number of spans in a chunk of buffer, about 160 kB
+static const size_t CHUNK = 4096;
+
+/// Trace whose threads have buffers of at most \a capacity spans.
+CCTrace::CCTrace(size_t capacity)
+: minPropagate(256), id(++nTraces), capacity(capacity),
+  start(std::chrono::steady_clock::now()) {}
+
+/// Buffer of the calling thread, created at its first call. The last one
+/// used by the thread is cached; otherwise, as when the thread alternates
+/// between traces, it is looked up.
+CCTrace::Buffer& CCTrace::buffer() {
+    thread_local unsigned int cachedId=0; // Trace of cached buffer, 0=none
+    thread_local Buffer* cached=0;
+    if(cachedId == id)
+        return *cached;
+    std::lock_guard<std::mutex> lock(mutex);
+    Buffer*& b = threads[std::this_thread::get_id()];
+    if(! b) {
+        buffers.emplace_back(new Buffer);
+        b = buffers.back().get();
+        b->tid = (int)buffers.size()-1;
+        b->size = b->nDropped = 0;
+    }
+    cachedId = id;
+    cached = b;
+    return *b;
+}
+
+/// Record span \a kind from \a begin to now, with arguments.
+void CCTrace::add(const Kind* kind, long long begin, int a0, int a1, int a2) {
+    long long end = now();
+    Buffer& b = buffer();
+    if(b.size == capacity) {
+        ++b.nDropped;
+        return;
+    }
+    if(b.chunks.empty() || b.chunks.back().size() == CHUNK) {
+        b.chunks.emplace_back();
+        b.chunks.back().reserve(CHUNK);
+    }
+    Event e = {kind, begin, end, {a0,a1,a2}};
+    b.chunks.back().push_back(e);
+    ++b.size;
+}
+
+/// Number of spans dropped because a buffer was full.
+size_t CCTrace::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n=0;
+    for(const std::unique_ptr<Buffer>& b: buffers)
+        n += b->nDropped;
+    return n;
+}
+
+bool CCTrace::write(const std::string& fileName) const {
+    FILE* f = fopen(fileName.c_str(), "w");
+    if(! f)
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t nDropped=0;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    const char* sep="\n";
+    for(const std::unique_ptr<Buffer>& b: buffers) {
+        nDropped += b->nDropped;
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                sep, b->tid, b->tid);
+        sep = ",\n";
+        for(const std::vector<Event>& chunk: b->chunks)
+            for(const Event& e: chunk) {
+                fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                        "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                        sep, e.kind->name, b->tid, e.begin/1e3,
+                        (e.end-e.begin)/1e3);
+                for(int i=0; i<3 && e.kind->arg[i]; i++)
+                    fprintf(f, "%s\"%s\":%d", i? ",": "", e.kind->arg[i],
+                            e.arg[i]);
+                fprintf(f, "}}");
+            }
+    }
+    fprintf(f, "\n],\"otherData\":{\"dropped\":%zu}}\n", nDropped);
+    return fclose(f) == 0;
+}
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file trace.h
+ * @brief Timeline of construction of C&C in trace-event format
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ *
+ * Spans are recorded for the levels of the pyramid, each merge of
+ * rectangles and the long propagations along their common edge. The file
+ * written loads in chrome://tracing or ui.perfetto.dev.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// Recorder of spans, shared by the threads building C&C. Each thread
+/// records in its own buffer, created at its first span and growing by
+/// chunks, so that recorded spans are never reallocated. Spans beyond the
+/// capacity of the buffer are dropped.
+struct CCTrace {
+    /// Name of span and of its integer arguments, static strings
+    struct Kind {
+        const char* name;
+        const char* arg[3]; ///< Null for unused argument
+    };
+    struct Event {
+        const Kind* kind;
+        long long begin, end; ///< Nanoseconds since creation of trace
+        int arg[3];
+    };
+    /// Propagations along chain codes of at least that total length are
+    /// recorded, shorter ones are part of their merge span.
+    size_t minPropagate;
+
+    explicit CCTrace(size_t capacity=1<<20);
+    long long now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now()-start).count();
+    }
+    void add(const Kind* kind, long long begin, int a0, int a1, int a2);
+    size_t dropped() const;
+    /// Write the JSON file, once the recording threads are done.
+    bool write(const std::string& fileName) const;
+private:
+    struct Buffer {
+        int tid; ///< Index of buffer, in order of first span
+        std::vector<std::vector<Event>> chunks; ///< Each of fixed capacity
+        size_t size; ///< Number of events in all chunks
+        size_t nDropped;
+    };
+    const unsigned int id; ///< Unique among traces, to find buffer of thread
+    const size_t capacity;
+    const std::chrono::steady_clock::time_point start;
+    mutable std::mutex mutex; ///< Guards buffers, not their content
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    std::unordered_map<std::thread::id,Buffer*> threads; ///< Guarded too
+    Buffer& buffer();
+};
+
+/// Scoped span, doing nothing if \a trace is null.
+struct CCSpan {
+    CCSpan(CCTrace* trace, const CCTrace::Kind& kind,
+           int a0=0, int a1=0, int a2=0)
+    : trace(trace), kind(&kind), begin(trace? trace->now(): 0) {
+        arg[0]=a0; arg[1]=a1; arg[2]=a2;
+    }
+    ~CCSpan() {
+        if(trace)
+            trace->add(kind, begin, arg[0], arg[1], arg[2]);
+    }
+    CCSpan(const CCSpan&) = delete;
+    CCSpan& operator=(const CCSpan&) = delete;
+private:
+    CCTrace* trace;
+    const CCTrace::Kind* kind;
+    long long begin;
+    int arg[3];
+};
+
+#endif
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file tree.cpp
+ * @brief Inclusion tree of the shapes of contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#include "tree.h"
+#include <algorithm>
+
+/// Build the tree from the graph of canonical contours and continua, which
+/// has no cycle, by a DFS from the contour of the top-left pixel.
+CCTree::CCTree(CC& cc) {
+    const int nCtr = (int)cc.contours.size(), nCtn = (int)cc.continua.size();
+    // Adjacency of canonical contours, in compressed rows
+    std::vector<int> inf(nCtn,-1), sup(nCtn,-1); // Canonical contours
+    std::vector<int> start(nCtr+1,0), adj;
+    for(int i=0; i<nCtn; i++)
+        if(cc.continua[i].parent < 0) {
+            ++start[(inf[i]=cc.root_contour(cc.continua[i].infCtr))+1];
+            ++start[(sup[i]=cc.root_contour(cc.continua[i].supCtr))+1];
+        }
+    for(int i=0; i<nCtr; i++)
+        start[i+1] += start[i];
+    adj.resize(start[nCtr]);
+    std::vector<int> fill(start.begin(), start.end()-1);
+    for(int i=0; i<nCtn; i++)
+        if(cc.continua[i].parent < 0) {
+            adj[fill[inf[i]]++] = i;
+            adj[fill[sup[i]]++] = i;
+        }
+
+    // DFS preorder numbering, one tree per component of a masked image
+    std::vector<int> node(nCtr, -1);
+    std::vector<int> stack, via, up;
+    for(int i=0; i<nCtr; i++) {
+        if(node[cc.root_contour(i)] >= 0)
+            continue;
+        stack.push_back(cc.root_contour(i)); via.push_back(-1); up.push_back(-1);
+        while(! stack.empty()) {
+            int c=stack.back(), e=via.back(), p=up.back();
+            stack.pop_back(); via.pop_back(); up.pop_back();
+            if(node[c] >= 0) // Cycle around a hole of the domain
+                continue;
+            int n = node[c] = (int)contour.size();
+            contour.push_back(c);
+            continuum.push_back(e);
+            parent.push_back(p);
+            for(int k=start[c]; k<start[c+1]; k++) {
+                int j=adj[k], d=(inf[j]==c)? sup[j]: inf[j];
+                if(j != e) {
+                    stack.push_back(d); via.push_back(j); up.push_back(n);
+                }
+            }
+        }
+    }
+    const int n = size();
+    firstChild.assign(n, -1);
+    nextSibling.assign(n, -1);
+    last.resize(n);
+    for(int i=n-1; i>=0; i--) { // Children in increasing order
+        last[i] = std::max(last[i], i);
+        if(parent[i] >= 0) {
+            nextSibling[i] = firstChild[parent[i]];
+            firstChild[parent[i]] = i;
+            last[parent[i]] = std::max(last[parent[i]], last[i]);
+        }
+    }
+    depth.assign(n, 0);
+    for(int i=1; i<n; i++)
+        if(parent[i] >= 0)
+            depth[i] = depth[parent[i]]+1;
+
+    ctrNode.resize(nCtr);
+    for(int i=0; i<nCtr; i++)
+        ctrNode[i] = node[cc.root_contour(i)];
+    ctnNode.resize(nCtn);
+    for(int i=0; i<nCtn; i++) {
+        int j = cc.root_continuum(i);
+        int a=node[inf[j]], b=node[sup[j]];
+        ctnNode[i] = (a<0 || b<0)? -1: (depth[a]>depth[b]? a: b);
+    }
+
+    // Sparse table of node of min depth over intervals of preorder
+    log2.assign(n+1, 0);
+    for(int i=2; i<=n; i++)
+        log2[i] = log2[i/2]+1;
+    sparse.resize(log2[n]+1);
+    sparse[0].resize(n);
+    for(int i=0; i<n; i++)
+        sparse[0][i] = i;
+    for(size_t k=1; k<sparse.size(); k++) {
+        int len = 1<<(k-1);
+        sparse[k].resize(n-2*len+1);
+        for(size_t i=0; i<sparse[k].size(); i++) {
+            int a=sparse[k-1][i], b=sparse[k-1][i+len];
+            sparse[k][i] = (depth[a]<=depth[b])? a: b;
+        }
+    }
+}
+
+/// Lowest common ancestor of nodes \a a and \a b. If neither is an ancestor
+/// of the other, the node of min depth between them in preorder is a child
+/// of the LCA. Return -1 if they are in different trees.
+int CCTree::lca(int a, int b) const {
+    if(a > b)
+        std::swap(a,b);
+    if(is_ancestor(a,b))
+        return a;
+    int k = log2[b-a];
+    int u=sparse[k][a+1], v=sparse[k][b-(1<<k)+1];
+    return parent[depth[u]<=depth[v]? u: v];
+}
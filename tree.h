@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MPL-2.0
+/**
+ * @file tree.h
+ * @brief Inclusion tree of the shapes of contours & continua
+ * @author Pascal Monasse <pascal.monasse@enpc.fr>
+ * @date 2025
+ */
+
+#ifndef TREE_H
+#define TREE_H
+
+#include "cc.h"
+#include <vector>
+
+/// Inclusion tree of shapes as flat arrays. Nodes are the canonical contours,
+/// linked by the canonical continua, and the root is the contour of the
+/// top-left pixel, on the frame of the image. A masked image gives a forest,
+/// one tree per component of its domain and per invalid pixel; roots have
+/// parent -1 and depth 0. Holes in the domain close cycles of contours and
+/// continua: some continua then link no node to its parent. Nodes are
+/// numbered in DFS preorder, so the subtree of node i is the interval
+/// [i,last[i]] and ancestor tests are O(1). A sparse table over the preorder
+/// gives the lowest common ancestor in O(1).
+struct CCTree {
+    std::vector<int> contour; ///< Canonical contour of each node
+    std::vector<int> continuum; ///< Continuum linking node to parent
+    std::vector<int> parent, firstChild, nextSibling; ///< -1 if none
+    std::vector<int> depth; ///< 0 for root
+    std::vector<int> last; ///< Last node of subtree
+    std::vector<int> ctrNode; ///< Node of each contour of the C&C
+    std::vector<int> ctnNode; ///< Node below each continuum of the C&C
+
+    explicit CCTree(CC& cc);
+    int size() const { return (int)contour.size(); }
+    /// Is node \a a an ancestor of node \a b (or \a b itself)?
+    bool is_ancestor(int a, int b) const { return a<=b && b<=last[a]; }
+    int lca(int a, int b) const;
+private:
+    std::vector<std::vector<int>> sparse; ///< Min depth node of 2^k nodes
+    std::vector<int> log2; ///< Floor of log2 of interval length
+};
+
+#endif